@@ -0,0 +1,22 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef DEDUP_HPP
+#define DEDUP_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "structs.hpp"
+
+namespace sasi::dedup {
+
+std::uint64_t hash(std::string_view seq);
+std::vector<std::vector<size_t>> groups(const sasi::data_t& data,
+                                        bool degap = false,
+                                        size_t threads = 1);
+void records(sasi::data_t& data, const sasi::args_t& args,
+             size_t threads = 1);
+
+}  // namespace sasi::dedup
+#endif
@@ -4,16 +4,83 @@
 #define FASTA_HPP
 
 #include <filesystem>
+#include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "profile.hpp"
 #include "structs.hpp"
 #include "utils.hpp"
 
 namespace sasi::fasta {
 
-sasi::data_t read_fasta(const std::string& f_path, bool ignore = false);
-bool write_fasta(sasi::data_t& fasta);
+// inputs smaller than this are always parsed by one thread
+constexpr size_t PARALLEL_PARSE_MIN{size_t{32} << 20};
+
+/**
+ * @brief Read-only view of a whole input: mapped file, or buffered stdin
+ * and non-regular files.
+ */
+class input_buffer_t {
+   public:
+    explicit input_buffer_t(const std::string& path);
+    input_buffer_t(const input_buffer_t&) = delete;
+    input_buffer_t& operator=(const input_buffer_t&) = delete;
+    input_buffer_t(input_buffer_t&&) = delete;
+    input_buffer_t& operator=(input_buffer_t&&) = delete;
+    ~input_buffer_t();
+
+    [[nodiscard]] std::string_view view() const { return view_; }
+
+   private:
+    std::string buffer_;
+    std::string_view view_;
+    int fd_{-1};
+    void* map_{nullptr};
+    size_t size_{0};
+};
+
+void parse_fasta(std::string_view buffer, sasi::data_t& fasta,
+                 size_t threads = 1);
+sasi::data_t read_fasta(const std::string& f_path, bool ignore = false,
+                        size_t threads = 1, bool qualities = false);
+sasi::data_t read_fasta(const std::string& f_path, const sasi::args_t& args);
+void select_records(sasi::data_t& fasta, const sasi::args_t& args,
+                    size_t threads = 1);
+
+/**
+ * @brief Buffered FASTA output with vectored writes.
+ *
+ * @details Names and sequences are referenced, not copied, until the next
+ * `flush`, and are then written with `writev` in batches of views, so
+ * records go from the parsed input to the output without an intermediate
+ * buffer. Sequences are wrapped every `line_width` characters (0 = one
+ * line).
+ */
+class writer_t {
+   public:
+    explicit writer_t(const std::string& path = "-", size_t line_width = 0);
+    writer_t(const writer_t&) = delete;
+    writer_t& operator=(const writer_t&) = delete;
+    writer_t(writer_t&&) = delete;
+    writer_t& operator=(writer_t&&) = delete;
+    ~writer_t();
+
+    void write(std::string_view name, std::string_view seq);
+    void write(const sasi::data_t& fasta, const std::vector<char>& keep = {});
+    void flush();
+
+   private:
+    std::vector<std::string_view> pieces_;
+    size_t width_{0};
+    int fd_{-1};
+    bool own_{false};
+    std::ofstream file_;  // used when writev is unavailable
+};
+
+bool write_fasta(const sasi::data_t& fasta, const std::string& out_file = "-",
+                 size_t line_width = 0);
 
 }  // namespace sasi::fasta
 
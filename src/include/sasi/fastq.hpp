@@ -0,0 +1,21 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef FASTQ_HPP
+#define FASTQ_HPP
+
+#include <string_view>
+
+#include "structs.hpp"
+
+namespace sasi::fastq {
+
+// Sanger / Illumina 1.8+ quality encoding
+constexpr size_t PHRED_OFFSET{33};
+
+void parse_fastq(std::string_view buffer, sasi::data_t& fastq,
+                 bool qualities = false);
+size_t count_below(std::string_view quals, size_t min_quality,
+                   size_t offset = PHRED_OFFSET);
+
+}  // namespace sasi::fastq
+#endif
@@ -5,16 +5,69 @@
 
 #include <CLI11.hpp>
 #include <cstring>
+#include <functional>
+#include <string_view>
 
 #include "fasta.hpp"
+#include "histogram.hpp"
+#include "mask.hpp"
 #include "output.hpp"
+#include "sample.hpp"
+#include "scheduler.hpp"
 #include "utils.hpp"
 
 namespace sasi::gap {
+
+// gap tables estimated from sampled records
+enum struct verb { FREQ, FRMST, PHASE, PHASE_RANGE, POSITION, JOINT, INDELS };
+
+/**
+ * @brief Call f(start, length) for every run of gaps in seq.
+ *
+ * @details seq is read as 64-column gap bitmaps and runs are found with bit
+ * scans, so gap-free stretches cost one compare per 16 characters. Batch
+ * kernels use the runs of `batch_t::gaps` instead; this is for records read
+ * without a mask, as `events` streams them.
+ */
+template <class F>
+void for_each_gap(std::string_view seq, F&& f) {
+    size_t start{seq.size()};  // start of the open run, size() if none
+    for(size_t i = 0; i < seq.size(); i += 64) {
+        size_t n = std::min<size_t>(64, seq.size() - i);
+        std::uint64_t bits = gap_bits(seq.data() + i, n);
+        size_t pos{0};
+        while(pos < n) {
+            bool open = start != seq.size();
+            pos = next_bit(bits, pos, n, !open);
+            if(pos == n) {
+                break;
+            }
+            if(open) {
+                f(start, i + pos - start);
+                start = seq.size();
+            } else {
+                start = i + pos;
+            }
+        }
+    }
+    if(start != seq.size()) {
+        f(start, seq.size() - start);
+    }
+}
+
+sasi::hist::histogram_t histogram(const sasi::args_t& args);
 std::vector<std::pair<size_t, size_t>> frequency(const sasi::args_t& args);
 std::pair<size_t, size_t> frameshift(
     const std::vector<std::pair<size_t, size_t>>& counts);
 std::vector<std::vector<size_t>> phase(const sasi::args_t& args);
+std::vector<std::vector<size_t>> phase_range(const sasi::args_t& args);
 std::vector<size_t> position(const sasi::args_t& args);
+std::vector<sasi::gap_cell_t> joint(const sasi::args_t& args);
+std::vector<sasi::indel_t> indels(const sasi::args_t& args);
+sasi::sample::table_t estimate(const sasi::args_t& args, verb statistic);
+void events(const sasi::args_t& args,
+            const std::function<void(const sasi::gap_event_t&)>& fn);
+void degap_columns(const sasi::args_t& args,
+                   const std::function<void(const sasi::data_t&)>& fn);
 }  // namespace sasi::gap
 #endif
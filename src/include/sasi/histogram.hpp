@@ -0,0 +1,72 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sasi::hist {
+
+// values below this are counted in a vector, larger ones in a sorted map
+constexpr size_t DENSE_MAX{size_t{1} << 16};
+// "auto" binning switches from exact to log bins above this many rows
+constexpr size_t AUTO_MAX_ROWS{1024};
+
+// exact: one row per value; automatic: exact, or log beyond AUTO_MAX_ROWS
+enum class binning { exact, linear, log, automatic };
+
+// closed value range [low, high] and its count
+struct bucket_t {
+   public:
+    size_t low{0};
+    size_t high{0};
+    size_t count{0};
+
+    bool operator==(const bucket_t& rhs) const {
+        return low == rhs.low && high == rhs.high && count == rhs.count;
+    }
+};
+
+/**
+ * @brief Counts of non-negative integer values.
+ *
+ * @details Small values go to a dense vector that grows on demand up to
+ * `DENSE_MAX`; larger values go to a sparse map, so a few very long gaps do
+ * not allocate a count for every length in between. Histograms are merged
+ * with `merge`, and bucketed only when written.
+ */
+class histogram_t {
+   public:
+    void add(size_t value, size_t n = 1) {
+        if(value < dense_.size()) {
+            dense_[value] += n;
+        } else {
+            grow(value, n);
+        }
+    }
+    void merge(const histogram_t& other);
+
+    [[nodiscard]] size_t total() const;
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] std::vector<std::pair<size_t, size_t>> counts() const;
+    [[nodiscard]] binning resolve(binning bins) const;
+    [[nodiscard]] std::vector<bucket_t> buckets(binning bins, size_t width = 1,
+                                                bool zeros = false) const;
+
+   private:
+    void grow(size_t value, size_t n);
+
+    std::vector<size_t> dense_;
+    std::map<size_t, size_t> sparse_;
+};
+
+binning parse_binning(const std::string& name);
+void write(const histogram_t& hist, binning bins, size_t width, bool zeros,
+           const std::string& label, std::ostream& out);
+
+}  // namespace sasi::hist
+#endif
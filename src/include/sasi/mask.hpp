@@ -0,0 +1,115 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef MASK_HPP
+#define MASK_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "structs.hpp"
+#include "utils.hpp"
+
+namespace sasi::gap {
+
+/** \brief Return index of the lowest set bit of x, x != 0 */
+inline size_t lowest_bit(std::uint64_t x) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctzll(x));
+#else
+    size_t i{0};
+    while((x & 1U) == 0) {
+        x >>= 1U;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+/**
+ * @brief First bit >= from of word whose value is value, or limit.
+ *
+ * @param limit number of meaningful bits of word, at most 64
+ */
+inline size_t next_bit(std::uint64_t word, size_t from, size_t limit,
+                       bool value) {
+    if(from >= limit) {
+        return limit;
+    }
+    if(!value) {
+        word = ~word;
+    }
+    word &= ~std::uint64_t{0} << from;
+    return word == 0 ? limit : std::min(limit, lowest_bit(word));
+}
+
+std::uint64_t gap_bits(const char* chars, size_t n);
+
+/**
+ * @brief One bit per column gap mask of a range of records, built once.
+ *
+ * @details Bit i of record r is set if column i is a gap. Gap counts and
+ * ungapped lengths are popcounts; gap runs, all-gap columns and degapping
+ * are word operations over it instead of rescans of the characters.
+ * Records keep their index in the data_t the mask was built from.
+ */
+class mask_t {
+   public:
+    mask_t() = default;
+    explicit mask_t(std::string_view seq);
+    mask_t(const sasi::data_t& data, size_t first, size_t last);
+    explicit mask_t(const sasi::data_t& data)
+        : mask_t(data, 0, data.seqs.size()) {}
+
+    /** \brief Return number of records */
+    [[nodiscard]] size_t size() const { return lengths_.size(); }
+    /** \brief Return number of columns of record r */
+    [[nodiscard]] size_t length(size_t r) const {
+        return lengths_[r - first_];
+    }
+    /** \brief Return whether column i of record r is a gap */
+    [[nodiscard]] bool gap(size_t r, size_t i) const {
+        return ((words_[offsets_[r - first_] + i / 64] >> (i % 64)) & 1U) !=
+               0;
+    }
+
+    [[nodiscard]] size_t count(size_t r) const;
+    /** \brief Return number of columns of record r that are not gaps */
+    [[nodiscard]] size_t ungapped(size_t r) const {
+        return length(r) - count(r);
+    }
+    bool and_gaps(std::vector<std::uint64_t>& all_gap) const;
+    void degap(size_t r, std::string_view seq, std::string& out) const;
+
+    /**
+     * @brief Call f(start, length) for every gap run of record r.
+     */
+    template <class F>
+    void for_each_run(size_t r, F&& f) const {
+        size_t start = next(r, 0, true);
+        while(start < length(r)) {
+            size_t stop = next(r, start, false);
+            f(start, stop - start);
+            start = next(r, stop, true);
+        }
+    }
+
+   private:
+    [[nodiscard]] size_t next(size_t r, size_t from, bool value) const;
+    void add(std::string_view seq);
+
+    size_t first_{0};  // index of the first record in its data_t
+    std::vector<size_t> lengths_;
+    std::vector<size_t> offsets_;  // first word of each record
+    std::vector<std::uint64_t> words_;
+};
+
+std::vector<std::uint64_t> gap_columns(const sasi::data_t& data,
+                                       size_t threads = 1);
+void compact(std::string& seq, const std::vector<std::uint64_t>& drop);
+size_t drop_gap_columns(sasi::data_t& data, size_t threads = 1);
+
+}  // namespace sasi::gap
+#endif
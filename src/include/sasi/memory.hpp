@@ -0,0 +1,33 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sasi::memory {
+
+// allocation counters of the calling thread
+struct counters_t {
+   public:
+    std::uint64_t allocs{0}; /*!< number of allocations */
+    std::uint64_t bytes{0};  /*!< bytes allocated */
+    std::int64_t live{0};    /*!< bytes allocated minus bytes freed */
+    std::int64_t peak{0};    /*!< high-water mark of live */
+};
+
+bool available();
+void enable(bool on = true);
+bool enabled();
+
+counters_t thread_counters();
+std::int64_t reset_thread_peak();
+void restore_thread_peak(std::int64_t peak);
+
+size_t heap_live();
+size_t heap_peak();
+size_t max_rss();
+
+}  // namespace sasi::memory
+#endif
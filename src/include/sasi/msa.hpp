@@ -0,0 +1,21 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef MSA_HPP
+#define MSA_HPP
+
+#include <string_view>
+
+#include "structs.hpp"
+
+namespace sasi::msa {
+
+// input formats selected by file_type_t::type_ext
+enum class format { fasta, phylip, stockholm, clustal, a3m, fastq };
+
+format input_format(std::string_view type_ext);
+void parse_stockholm(std::string_view buffer, sasi::data_t& msa);
+void parse_clustal(std::string_view buffer, sasi::data_t& msa);
+void parse_a3m(std::string_view buffer, sasi::data_t& msa);
+
+}  // namespace sasi::msa
+#endif
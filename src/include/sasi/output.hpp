@@ -3,20 +3,54 @@
 #ifndef OUTPUT_HPP
 #define OUTPUT_HPP
 
+#include "histogram.hpp"
+#include "sequence.hpp"
 #include "structs.hpp"
 
 namespace sasi::gap::output {
+void histogram(const sasi::hist::histogram_t& hist, const sasi::args_t& args,
+               std::ostream& out);
 void frequency(const std::vector<std::pair<size_t, size_t>>& counts,
                std::ostream& out);
 void frameshift(const std::pair<size_t, size_t>& gaps, std::ostream& out);
 void phase(const std::vector<std::vector<size_t>>& phases, std::ostream& out);
+void phase_range(const std::vector<std::vector<size_t>>& phases, size_t k_min,
+                 std::ostream& out);
 void position(const std::vector<size_t>& positions, std::ostream& out);
+void joint(const std::vector<sasi::gap_cell_t>& cells, std::ostream& out);
+void indels(const std::vector<sasi::indel_t>& indels,
+            const std::vector<std::string>& files, std::ostream& out);
+void events_header(const std::string& format,
+                   const std::vector<std::string>& files, std::ostream& out);
+void event(const sasi::gap_event_t& event, const std::string& format,
+           std::ostream& out);
 }  // namespace sasi::gap::output
 
 namespace sasi::seq::output {
 void ambiguous(const size_t count, std::ostream& out);
+void ambiguous(const std::pair<size_t, size_t> counts, std::ostream& out);
 void frameshift(const std::pair<size_t, size_t> count, std::ostream& out);
 void stop_codons(const std::vector<std::string>& count, std::ostream& out);
 void subst(const std::vector<std::size_t>& count, std::ostream& out);
+void subst_matrix(const sasi::seq::subst_matrix_t& matrix, std::ostream& out);
+void composition(
+    const std::vector<std::pair<std::string, sasi::seq::composition_t>>& rows,
+    sasi::info_detail detail, std::ostream& out, bool quality = false);
+void codons(
+    const std::vector<std::pair<std::string, sasi::seq::codon_counts_t>>& rows,
+    const sasi::args_t& args, std::ostream& out);
+void distance(const std::vector<sasi::seq::distance_matrix_t>& matrices,
+              const std::string& format, std::ostream& out);
+void duplicates(
+    const std::vector<std::pair<std::string, std::vector<std::string>>>& groups,
+    std::ostream& out);
+void residues(
+    const std::vector<std::pair<std::string, sasi::seq::residue_counts_t>>&
+        rows,
+    std::ostream& out);
+void window_header(std::ostream& out);
+void window(const std::string& file, const std::string& name,
+            const sasi::seq::prefix_counts_t& sums, size_t size, size_t step,
+            std::ostream& out);
 }  // namespace sasi::seq::output
 #endif
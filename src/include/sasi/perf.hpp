@@ -0,0 +1,27 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace sasi::perf {
+
+// hardware counters of the calling thread (user space only)
+struct counters_t {
+   public:
+    std::uint64_t cycles{0};
+    std::uint64_t instructions{0};
+    std::uint64_t cache_misses{0};
+    std::uint64_t branch_misses{0};
+};
+
+bool enable(bool on = true);
+bool enabled();
+std::string error();
+
+bool read(counters_t& counters);
+
+}  // namespace sasi::perf
+#endif
@@ -0,0 +1,22 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef PHYLIP_HPP
+#define PHYLIP_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "structs.hpp"
+
+namespace sasi::phylip {
+
+// strict PHYLIP names fill the first 10 columns
+constexpr size_t STRICT_NAME{10};
+
+bool is_phylip(std::string_view type_ext);
+void parse_phylip(std::string_view buffer, sasi::data_t& phylip);
+std::vector<std::string> strict_names(const std::vector<std::string>& names);
+
+}  // namespace sasi::phylip
+#endif
@@ -0,0 +1,102 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory.hpp"
+#include "perf.hpp"
+
+namespace sasi::profile {
+
+// accumulated cost of one stage (parse, statistic kernel or output writer)
+struct stage_t {
+   public:
+    std::string name;
+    size_t calls{0};
+    std::uint64_t total_ns{0}; /*!< wall time including nested stages */
+    std::uint64_t self_ns{0};  /*!< wall time excluding nested stages */
+    size_t bytes{0};
+    size_t records{0};
+    std::uint64_t allocs{0};      /*!< allocations, with --profile-memory */
+    std::uint64_t alloc_bytes{0}; /*!< bytes allocated */
+    std::int64_t peak_bytes{0};   /*!< high-water mark above stage start */
+    sasi::perf::counters_t hw;    /*!< self counters, with --perf-counters */
+};
+
+// accumulated cost of one input file over all stages
+struct file_t {
+   public:
+    std::string name;
+    std::uint64_t ns{0};
+    size_t bytes{0};
+    size_t records{0};
+    std::uint64_t allocs{0};
+    std::uint64_t alloc_bytes{0};
+    std::int64_t peak_bytes{0};
+};
+
+void enable(bool on = true);
+bool enabled();
+void reset();
+
+std::vector<stage_t> stages();
+std::vector<file_t> files();
+
+void report(std::ostream& out, size_t top = 10);
+void report_json(std::ostream& out, size_t top = 10);
+void write_report(const std::string& out_file, size_t top = 10);
+
+/**
+ * @brief RAII timer for one stage.
+ *
+ * @details Does nothing unless profiling is enabled. Time spent in scopes
+ * opened while this one is active is subtracted from its self time, so a
+ * statistic kernel calling `read_fasta` reports parse and count separately.
+ * With memory tracking enabled, allocations made by the calling thread
+ * are attributed the same way and the peak is measured from scope start.
+ * Hardware counters, when enabled, are read at both ends and reported as
+ * self counts.
+ */
+class scope {
+   public:
+    explicit scope(std::string_view stage, std::string_view file = {});
+    ~scope();
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+    scope(scope&&) = delete;
+    scope& operator=(scope&&) = delete;
+
+    /** \brief Add processed bytes and records to this stage */
+    void add(size_t bytes, size_t records = 0) {
+        bytes_ += bytes;
+        records_ += records;
+    }
+
+   private:
+    bool active_{false};
+    std::string_view stage_;
+    std::string_view file_;
+    std::chrono::steady_clock::time_point start_;
+    std::uint64_t child_ns_{0};
+    size_t bytes_{0};
+    size_t records_{0};
+    scope* parent_{nullptr};
+    bool track_memory_{false};
+    sasi::memory::counters_t memory_start_;
+    std::int64_t saved_peak_{0};
+    std::uint64_t child_allocs_{0};
+    std::uint64_t child_alloc_bytes_{0};
+    bool track_hw_{false};
+    sasi::perf::counters_t hw_start_;
+    sasi::perf::counters_t child_hw_;
+};
+
+}  // namespace sasi::profile
+#endif
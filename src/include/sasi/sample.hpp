@@ -0,0 +1,178 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef SAMPLE_HPP
+#define SAMPLE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "profile.hpp"
+#include "scheduler.hpp"
+#include "structs.hpp"
+
+namespace sasi::sample {
+
+// normal quantile for 95% confidence intervals
+constexpr double Z_95{1.959963984540054};
+
+// estimate of a population total from a record sample
+struct estimate_t {
+   public:
+    double value{0};
+    double low{0};  /*!< lower bound of the confidence interval */
+    double high{0}; /*!< upper bound of the confidence interval */
+    size_t sampled{0};
+    size_t records{0}; /*!< records before sampling */
+};
+
+// sums of a per-record value over the sampled records of one file
+struct stratum_t {
+   public:
+    double sum{0};
+    double sum_sq{0}; /*!< sum of squared values */
+    size_t sampled{0};
+    size_t records{0}; /*!< records before sampling */
+};
+
+// table of estimates, one row per cell
+struct table_t {
+   public:
+    std::string labels; /*!< names of the label columns, "a,b" */
+    std::vector<std::pair<std::string, estimate_t>> rows;
+};
+
+// sums of one cell's per-record values over the sampled records of a file
+struct sums_t {
+   public:
+    double sum{0};
+    double sum_sq{0}; /*!< sum of squared values */
+};
+
+estimate_t total(const std::vector<stratum_t>& strata, double z = Z_95);
+estimate_t total(const std::vector<stratum_t>& files,
+                 const std::map<size_t, sums_t>& sums, double z = Z_95);
+
+// per-file sums of every cell of a count table over sampled records
+template <class Key>
+struct cells_t {
+   public:
+    std::vector<stratum_t> files; /*!< sampled and records, no sums */
+    std::map<Key, std::map<size_t, sums_t>> cells; /*!< files with the cell */
+
+    /** \brief Return stratum of cell key in file f, zero sums if absent */
+    [[nodiscard]] stratum_t stratum(const Key& key, size_t f) const {
+        stratum_t ret = files[f];
+        auto it = cells.find(key);
+        if(it != cells.end()) {
+            auto sums = it->second.find(f);
+            if(sums != it->second.end()) {
+                ret.sum = sums->second.sum;
+                ret.sum_sq = sums->second.sum_sq;
+            }
+        }
+        return ret;
+    }
+
+    /** \brief Estimate cell key over every file, zero if no record has it */
+    [[nodiscard]] estimate_t total(const Key& key) const {
+        auto it = cells.find(key);
+        if(it == cells.end()) {
+            return sample::total(files);
+        }
+        return sample::total(files, it->second);
+    }
+};
+
+bool active(const sasi::args_t& args);
+std::uint64_t seed(const sasi::args_t& args, std::string_view path);
+void records(sasi::data_t& data, const sasi::args_t& args);
+estimate_t total(double sum, double sum_sq, size_t sampled, size_t records,
+                 double z = Z_95);
+void write(const table_t& table, std::ostream& out);
+
+/**
+ * @brief Count a table over the sampled records of every input file.
+ *
+ * @details `fn(batch, i, add)` calls `add(cell, count)` for the counts
+ * record i adds to the cells of the table, in any order and possibly more
+ * than once per cell. The per-record count of every cell is summed, with its
+ * square, per input file, so that `cells_t::total` estimates the cell over
+ * all records: the value of each record, not of each count, is the sampled
+ * unit. Only the files where a cell occurs keep sums for it.
+ */
+template <class Key, class F>
+cells_t<Key> cells(const sasi::args_t& args, std::string_view stage,
+                   F&& fn) {
+    struct acc_t {
+        std::vector<stratum_t> files;
+        std::map<std::pair<size_t, Key>, std::pair<double, double>> sums;
+    };
+    acc_t init;
+    init.files.resize(args.input.size());
+    auto accs = sasi::sched::for_each_batch<acc_t>(
+        args,
+        [&args, &fn, stage](acc_t& acc, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{stage, args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            stratum_t& file = acc.files[batch.file];
+            // records before sampling are counted once per file
+            if(batch.first == 0) {
+                file.records += batch.data->records;
+            }
+            std::vector<std::pair<Key, size_t>> record;
+            auto add = [&record](const Key& cell, size_t count) {
+                record.emplace_back(cell, count);
+            };
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                record.clear();
+                fn(batch, i, add);
+                std::sort(record.begin(), record.end(),
+                          [](const auto& a, const auto& b) {
+                              return a.first < b.first;
+                          });
+                for(size_t j = 0; j < record.size();) {
+                    double y{0};
+                    size_t k = j;
+                    for(; k < record.size() &&
+                          !(record[j].first < record[k].first);
+                        ++k) {
+                        y += static_cast<double>(record[k].second);
+                    }
+                    auto& sums = acc.sums[{batch.file, record[j].first}];
+                    sums.first += y;
+                    sums.second += y * y;
+                    j = k;
+                }
+                file.sampled++;
+            }
+        },
+        true, init);
+
+    // merge worker sums
+    acc_t merged{init};
+    for(const auto& acc : accs) {
+        for(size_t f = 0; f < merged.files.size(); ++f) {
+            merged.files[f].sampled += acc.files[f].sampled;
+            merged.files[f].records += acc.files[f].records;
+        }
+        for(const auto& [key, sums] : acc.sums) {
+            auto& total = merged.sums[key];
+            total.first += sums.first;
+            total.second += sums.second;
+        }
+    }
+    cells_t<Key> ret;
+    ret.files = merged.files;
+    for(const auto& [key, sums] : merged.sums) {
+        ret.cells[key.second][key.first] = {sums.first, sums.second};
+    }
+    return ret;
+}
+
+}  // namespace sasi::sample
+#endif
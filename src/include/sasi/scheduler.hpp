@@ -0,0 +1,143 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "fasta.hpp"
+#include "mask.hpp"
+#include "structs.hpp"
+#include "utils.hpp"
+
+namespace sasi::sched {
+
+// files with more sequence bytes than this are split into record batches
+constexpr size_t SPLIT_MIN_BYTES{size_t{4} << 20};
+// target number of sequence bytes per batch
+constexpr size_t BATCH_BYTES{size_t{1} << 20};
+
+// contiguous range of records [first, last) of one input file
+struct batch_t {
+   public:
+    std::shared_ptr<const sasi::data_t> data;
+    size_t file{0}; /*!< index of the file in args.input */
+    size_t first{0};
+    size_t last{0};
+    // gap mask of the batch, built by gaps() on first use
+    mutable std::shared_ptr<const sasi::gap::mask_t> mask{};
+
+    /** \brief Return sequence at record index i */
+    [[nodiscard]] std::string_view seq(size_t i) const {
+        return data->seqs[i];
+    }
+
+    /** \brief Return FASTQ quality of record index i, empty if not read */
+    [[nodiscard]] std::string_view qual(size_t i) const {
+        return data->quals.empty() ? std::string_view{} : data->quals[i];
+    }
+
+    /**
+     * @brief Gap mask of records [first, last), indexed as data.
+     *
+     * @details Built once, on first use, by the one worker that runs the
+     * batch, so gap counts, ungapped lengths and degapping of a record
+     * share one scan of its characters.
+     */
+    [[nodiscard]] const sasi::gap::mask_t& gaps() const {
+        if(!mask) {
+            mask = std::make_shared<const sasi::gap::mask_t>(*data, first,
+                                                             last);
+        }
+        return *mask;
+    }
+
+    /** \brief Return number of characters in the batch */
+    [[nodiscard]] size_t bytes() const {
+        size_t total{0};
+        for(size_t i = first; i < last; ++i) {
+            total += data->seqs[i].size();
+        }
+        return total;
+    }
+};
+
+/**
+ * @brief Work-stealing task pool.
+ *
+ * @details Every worker owns a deque: it pops its own tasks from the back
+ * and, when empty, steals from the front of the other workers' deques.
+ * Tasks may push more tasks. Workers with nothing to steal sleep until a
+ * task is pushed or the last task finishes. `run` returns once every task
+ * has finished and rethrows the first exception thrown by a task.
+ */
+class pool_t {
+   public:
+    using task_t = std::function<void(size_t worker)>;
+
+    explicit pool_t(size_t threads);
+
+    void push(size_t worker, task_t task);
+    void run();
+    [[nodiscard]] size_t size() const { return queues_.size(); }
+
+   private:
+    struct queue_t {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    bool pop(size_t worker, task_t& task);
+    void work(size_t worker);
+
+    std::vector<std::unique_ptr<queue_t>> queues_;
+    std::atomic<size_t> pending_{0};
+    std::mutex idle_mutex_;
+    std::condition_variable idle_;
+    size_t epoch_{0};  // bumped on push and when the last task finishes
+    std::atomic<bool> failed_{false};
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
+
+void schedule_files(const sasi::args_t& args, pool_t& pool,
+                    std::function<void(size_t, const batch_t&)> fn,
+                    size_t split_min = SPLIT_MIN_BYTES,
+                    size_t batch_bytes = BATCH_BYTES);
+
+/**
+ * @brief Apply fn(acc, batch) to every record batch of every input file.
+ *
+ * @details Each worker updates its own accumulator, so `fn` needs no
+ * locking; the caller merges the returned accumulators. Files above
+ * `SPLIT_MIN_BYTES` are cut into batches that idle workers can steal,
+ * unless `split` is false (statistics that need the whole file).
+ *
+ * @return one accumulator per worker.
+ */
+template <class Acc, class F>
+std::vector<Acc> for_each_batch(const sasi::args_t& args, F&& fn,
+                                bool split = true, const Acc& init = Acc{}) {
+    pool_t pool(sasi::utils::thread_count(args.threads));
+    std::vector<Acc> accs(pool.size(), init);
+    schedule_files(
+        args, pool,
+        [&accs, &fn](size_t worker, const batch_t& batch) {
+            fn(accs[worker], batch);
+        },
+        split ? SPLIT_MIN_BYTES : SIZE_MAX);
+    pool.run();
+    return accs;
+}
+
+}  // namespace sasi::sched
+#endif
@@ -4,15 +4,262 @@
 #define SEQUENCE_HPP
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <tuple>
 
 #include "fasta.hpp"
+#include "sample.hpp"
+#include "scheduler.hpp"
 
 namespace sasi::seq {
-enum struct verb { STOP = 0, FRMST = 1, AMB = 2 };
+enum struct verb { STOP = 0, FRMST = 1, AMB = 2, COMP = 3, CODON = 4 };
+
+/** \brief Whether a codon is one of the stop codons TAA, TAG or TGA */
+constexpr bool is_stop(char a, char b, char c) {
+    return a == 'T' && ((b == 'A' && (c == 'A' || c == 'G')) ||
+                        (b == 'G' && c == 'A'));
+}
+
+// character classes, combined as bit flags in BASE_CLASS
+constexpr std::uint8_t CLASS_GAP{1U};
+constexpr std::uint8_t CLASS_AMB{2U};
+constexpr std::uint8_t CLASS_GC{4U};
+
+/** \brief Build the character class table, indexed by unsigned char */
+constexpr std::array<std::uint8_t, 256> make_base_class() {
+    std::array<std::uint8_t, 256> table{};
+    table[static_cast<unsigned char>(GAP)] = CLASS_GAP;
+    for(char c : std::string_view{"ryswkmbdhvnRYSWKMBDHVN"}) {
+        table[static_cast<unsigned char>(c)] = CLASS_AMB;
+    }
+    for(char c : std::string_view{"gcGC"}) {
+        table[static_cast<unsigned char>(c)] = CLASS_GC;
+    }
+    return table;
+}
+constexpr std::array<std::uint8_t, 256> BASE_CLASS{make_base_class()};
+
+// counts of gaps, ambiguous nucleotides and G/C in a range of a sequence
+struct window_counts_t {
+   public:
+    size_t gaps{0};
+    size_t ambiguous{0};
+    size_t gc{0};
+
+    bool operator==(const window_counts_t& o) const {
+        return gaps == o.gaps && ambiguous == o.ambiguous && gc == o.gc;
+    }
+};
+
+/**
+ * @brief Prefix sums of gap, ambiguous and G/C counts of one sequence.
+ *
+ * @details After `build`, the counts of any range are two lookups. Buffers
+ * are kept between records, so one object is reused for a whole file.
+ */
+class prefix_counts_t {
+   public:
+    void build(std::string_view seq);
+    [[nodiscard]] window_counts_t count(size_t begin, size_t end) const;
+    /** \brief Length of the sequence */
+    [[nodiscard]] size_t size() const {
+        return gaps_.empty() ? 0 : gaps_.size() - 1;
+    }
+
+   private:
+    std::vector<std::uint32_t> gaps_;
+    std::vector<std::uint32_t> ambiguous_;
+    std::vector<std::uint32_t> gc_;
+};
+
+// nucleotide composition of a sequence, a file or all input
+struct composition_t {
+   public:
+    size_t a{0};
+    size_t c{0};
+    size_t g{0};
+    size_t t{0};
+    size_t gaps{0};
+    size_t ambiguous{0};
+    size_t other{0};
+    size_t low_quality{0}; /*!< FASTQ bases below args.min_quality */
+
+    composition_t& operator+=(const composition_t& o) {
+        a += o.a;
+        c += o.c;
+        g += o.g;
+        t += o.t;
+        gaps += o.gaps;
+        ambiguous += o.ambiguous;
+        other += o.other;
+        low_quality += o.low_quality;
+        return *this;
+    }
+    bool operator==(const composition_t& o) const {
+        return a == o.a && c == o.c && g == o.g && t == o.t &&
+               gaps == o.gaps && ambiguous == o.ambiguous &&
+               other == o.other && low_quality == o.low_quality;
+    }
+    /** \brief Fraction of G and C among A, C, G and T */
+    [[nodiscard]] double gc_content() const {
+        size_t acgt = a + c + g + t;
+        return acgt == 0 ? 0.0
+                         : static_cast<double>(c + g) /
+                               static_cast<double>(acgt);
+    }
+};
+
+composition_t count_bases(std::string_view seq);
+
+constexpr size_t N_CODONS{64};
+// codon index = 16 * first + 4 * second + third, with A C G T = 0 1 2 3
+constexpr std::uint8_t NOT_ACGT{4U};
+
+/** \brief Build the nucleotide index table, indexed by unsigned char */
+constexpr std::array<std::uint8_t, 256> make_nuc_index() {
+    std::array<std::uint8_t, 256> table{};
+    for(auto& entry : table) {
+        entry = NOT_ACGT;
+    }
+    std::string_view upper{"ACGT"}, lower{"acgt"};
+    for(std::uint8_t i = 0; i < 4; ++i) {
+        table[static_cast<unsigned char>(upper[i])] = i;
+        table[static_cast<unsigned char>(lower[i])] = i;
+    }
+    table[static_cast<unsigned char>('U')] = 3;
+    table[static_cast<unsigned char>('u')] = 3;
+    return table;
+}
+constexpr std::array<std::uint8_t, 256> NUC_INDEX{make_nuc_index()};
+
+// usage of the 64 codons, indexed by packed codon
+struct codon_counts_t {
+   public:
+    std::array<size_t, N_CODONS> counts{};
+
+    codon_counts_t& operator+=(const codon_counts_t& o) {
+        for(size_t i = 0; i < N_CODONS; ++i) {
+            counts[i] += o.counts[i];
+        }
+        return *this;
+    }
+    bool operator==(const codon_counts_t& o) const {
+        return counts == o.counts;
+    }
+};
+
+// aligned base pairs per codon phase: [phase][base1][base2], with
+// bases A C G T and other (NOT_ACGT); pairs with a gap are not counted
+struct subst_matrix_t {
+   public:
+    std::array<std::array<std::array<size_t, 5>, 5>, 3> counts{};
+
+    subst_matrix_t& operator+=(const subst_matrix_t& o) {
+        for(size_t p = 0; p < 3; ++p) {
+            for(size_t a = 0; a < 5; ++a) {
+                for(size_t b = 0; b < 5; ++b) {
+                    counts[p][a][b] += o.counts[p][a][b];
+                }
+            }
+        }
+        return *this;
+    }
+    /** \brief A <-> G and C <-> T changes in phase p */
+    [[nodiscard]] size_t transitions(size_t p) const {
+        return counts[p][0][2] + counts[p][2][0] + counts[p][1][3] +
+               counts[p][3][1];
+    }
+    /** \brief Changes between a purine and a pyrimidine in phase p */
+    [[nodiscard]] size_t transversions(size_t p) const {
+        size_t changes{0};
+        for(size_t a = 0; a < 4; ++a) {
+            for(size_t b = 0; b < 4; ++b) {
+                changes += a != b ? counts[p][a][b] : 0;
+            }
+        }
+        return changes - transitions(p);
+    }
+};
+
+// pairwise distances between the sequences of one alignment
+struct distance_matrix_t {
+   public:
+    std::string file;
+    std::vector<std::string> names;
+    // condensed upper triangle, pairs (0,1), (0,2), ..., (1,2), ...
+    std::vector<size_t> mismatches; /*!< A/C/G/T sites that differ */
+    std::vector<size_t> compared;   /*!< sites with A/C/G/T in both */
+    std::vector<size_t> gaps;       /*!< sites with a gap in both */
+
+    /** \brief Index of pair (i, j), i < j, in the condensed vectors */
+    [[nodiscard]] size_t pair(size_t i, size_t j) const {
+        size_t n = names.size();
+        return i * n - i * (i + 1) / 2 + (j - i - 1);
+    }
+    /** \brief Proportion of differing sites (p-distance), NaN if none */
+    [[nodiscard]] double p(size_t i, size_t j) const {
+        if(i == j) {
+            return 0.0;
+        }
+        size_t k = i < j ? pair(i, j) : pair(j, i);
+        return compared[k] == 0 ? std::numeric_limits<double>::quiet_NaN()
+                                : static_cast<double>(mismatches[k]) /
+                                      static_cast<double>(compared[k]);
+    }
+};
+
+// amino acid of every codon packed as three 3-bit classes (codon_class)
+using codon_table_t = std::array<char, 512>;
+// occurrences of every character, indexed by unsigned char
+using residue_counts_t = std::array<size_t, 256>;
+
+std::string codon_name(size_t index);
+std::string genetic_code(size_t id);
+codon_table_t codon_table(const std::string& code);
+std::string translate(std::string_view seq, const codon_table_t& table);
+std::string reverse_complement(std::string_view seq);
+residue_counts_t count_residues(const sasi::data_t& data);
+void count_codons(std::string_view seq, codon_counts_t& counts);
+std::array<double, N_CODONS> rscu(const codon_counts_t& counts,
+                                  const std::string& code);
+std::vector<std::pair<char, size_t>> amino_acid_counts(
+    const codon_counts_t& counts, const std::string& code);
+
+using window_fn_t = std::function<void(
+    const std::string& file, const std::string& name, const prefix_counts_t&)>;
+// records of one file and whether each passed the filters
+using filter_fn_t =
+    std::function<void(const sasi::data_t&, const std::vector<char>&)>;
+
+size_t count_ambiguous(std::string_view seq);
+size_t count_stops(std::string_view seq, bool keep_last);
 std::size_t ambiguous(const sasi::args_t& args);
+std::pair<size_t, size_t> ambiguous_quality(const sasi::args_t& args);
 std::pair<size_t, size_t> frameshift(const sasi::args_t& args);
 std::vector<std::string> stop_codons(const sasi::args_t& args);
 std::vector<std::size_t> subst(const sasi::args_t& args);
+subst_matrix_t subst_matrix(const sasi::args_t& args);
+distance_matrix_t distance(const sasi::data_t& data, size_t threads = 1);
+std::vector<distance_matrix_t> distance(const sasi::args_t& args);
+sasi::sample::table_t estimate(const sasi::args_t& args, verb statistic);
+std::vector<std::pair<std::string, std::vector<std::string>>> duplicates(
+    const sasi::args_t& args);
+void window(const sasi::args_t& args, const window_fn_t& fn);
+bool passes(std::string_view seq, const sasi::args_t& args);
+bool passes(const sasi::gap::mask_t& gaps, size_t r, std::string_view seq,
+            const sasi::args_t& args);
+void translate(const sasi::args_t& args,
+               const std::function<void(const sasi::data_t&)>& fn);
+void filter(const sasi::args_t& args, const filter_fn_t& fn);
+std::vector<std::pair<std::string, composition_t>> composition(
+    const sasi::args_t& args);
+std::vector<std::pair<std::string, codon_counts_t>> codons(
+    const sasi::args_t& args);
 }  // namespace sasi::seq
 #endif
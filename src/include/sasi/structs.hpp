@@ -5,7 +5,9 @@
 
 #include <CLI11.hpp>
 #include <algorithm>
+#include <cstdint>
 #include <filesystem>
+#include <numeric>
 #include <vector>
 
 namespace sasi {
@@ -22,6 +24,9 @@ class data_t {
     std::filesystem::path path;     /*!< path to input file */
     std::vector<std::string> names; /*!< names of fasta sequences */
     std::vector<std::string> seqs;  /*!< fasta sequences */
+    std::vector<std::string> quals; /*!< FASTQ qualities, only if requested */
+    std::vector<size_t> ids; /*!< index in the file, only once compacted */
+    size_t records{0};       /*!< records in file before sampling */
 
     data_t() = default;
     explicit data_t(std::filesystem::path p, std::vector<std::string> n = {},
@@ -55,6 +60,92 @@ class data_t {
                                 })
             ->size();
     }
+
+    /** \brief Return index in the file of record i, before any was dropped */
+    [[nodiscard]] size_t id(size_t i) const {
+        return ids.empty() ? i : ids[i];
+    }
+
+    /** \brief Move record from to position to, as when compacting */
+    void move_record(size_t from, size_t to) {
+        // records keep their index in the file once they move
+        if(ids.empty()) {
+            ids.resize(seqs.size());
+            std::iota(ids.begin(), ids.end(), size_t{0});
+        }
+        ids[to] = ids[from];
+        names[to] = std::move(names[from]);
+        seqs[to] = std::move(seqs[from]);
+        if(!quals.empty()) {
+            quals[to] = std::move(quals[from]);
+        }
+    }
+
+    /** \brief Keep the first n records */
+    void truncate(size_t n) {
+        names.resize(n);
+        seqs.resize(n);
+        if(!quals.empty()) {
+            quals.resize(n);
+        }
+        if(!ids.empty()) {
+            ids.resize(n);
+        }
+    }
+
+    /** \brief Return total number of characters over all sequences */
+    [[nodiscard]] size_t bases() const {
+        size_t total{0};
+        for(const auto& seq : seqs) {
+            total += seq.size();
+        }
+        return total;
+    }
+};
+
+// one non-empty cell of the gap length x phase x position histogram
+struct gap_cell_t {
+   public:
+    size_t length{0};
+    size_t phase{0};    /*!< phase of first gap position */
+    size_t position{0}; /*!< relative position (%) of first gap position */
+    size_t count{0};
+
+    bool operator==(const gap_cell_t& o) const {
+        return length == o.length && phase == o.phase &&
+               position == o.position && count == o.count;
+    }
+};
+
+// one run of gaps, as streamed by gap::events
+struct gap_event_t {
+   public:
+    size_t file{0};   /*!< index of the file in args.input */
+    size_t record{0}; /*!< index of the sequence in its file */
+    size_t start{0};
+    size_t length{0};
+    size_t phase{0};  /*!< phase of first gap position */
+    bool frameshift{false};
+
+    bool operator==(const gap_event_t& o) const {
+        return file == o.file && record == o.record && start == o.start &&
+               length == o.length && phase == o.phase &&
+               frameshift == o.frameshift;
+    }
+};
+
+// distinct gap run of an alignment and the number of sequences sharing it
+struct indel_t {
+   public:
+    size_t file{0}; /*!< index of the file in args.input */
+    size_t start{0};
+    size_t length{0};
+    size_t support{0};
+
+    bool operator==(const indel_t& o) const {
+        return file == o.file && start == o.start && length == o.length &&
+               support == o.support;
+    }
 };
 
 enum struct info_detail { TOTAL = 0, FILE = 1, SEQ = 2 };
@@ -63,13 +154,51 @@ struct args_t {
    public:
     CLI::App* gap;
     CLI::App* seq;
+    CLI::App* filter;
+    CLI::App* degap;
     info_detail stop_inf{info_detail::TOTAL};
+    info_detail comp_inf{info_detail::TOTAL};
+    info_detail codon_inf{info_detail::TOTAL};
+    size_t genetic_code{1};
+    bool rscu{false};
+    bool amino_acids{false};
+    bool subst_matrix{false};
+    std::string distance_format{"phylip"};
+    std::string events_format{"csv"};
+    bool unique_indels{false};
+    std::string bins{"exact"};
+    bool zeros{false};
+    bool drop_gap_columns{false};
+    double sample_fraction{1.0};
+    size_t sample_records{0};
+    std::uint64_t seed{1};
+    bool dedup{false};
     bool discard_gaps{false};
     std::vector<std::string> input;
     bool stop_keep_last{false};
+    size_t max_ambiguous{SIZE_MAX};
+    double max_gap_fraction{1.0};
+    bool no_stops{false};
+    bool no_frameshift{false};
+    size_t line_width{0};
+    size_t frame{1};
+    bool six_frames{false};
+    bool residue_counts{false};
+    size_t min_quality{0}; /*!< Phred threshold of low quality, 0 = off */
+    size_t phred_offset{33};
     std::string output{""};
     bool ignore_empty{false};
     size_t k{3};
+    std::vector<size_t> k_range;
+    size_t bin_width{1};
+    size_t window_size{100};
+    size_t window_step{100};
+    bool profile{false};
+    std::string profile_out{""};
+    size_t profile_top{10};
+    bool profile_memory{false};
+    bool perf_counters{false};
+    size_t threads{1};
 };
 
 }  // namespace sasi
@@ -0,0 +1,62 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#ifndef TAR_HPP
+#define TAR_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "fasta.hpp"
+
+namespace sasi::tar {
+
+// tar headers and member data are padded to 512-byte blocks
+constexpr size_t BLOCK{512};
+
+// regular file inside an archive
+struct member_t {
+   public:
+    std::string name;
+    size_t offset{0}; /*!< start of the data in the archive */
+    size_t size{0};
+};
+
+std::vector<member_t> index(std::string_view buffer,
+                            const std::string& path = "");
+
+/**
+ * @brief Memory-mapped tar archive and the index of its regular files.
+ *
+ * @details Members are views of the mapping, so they are parsed without
+ * being copied or extracted.
+ */
+class archive_t {
+   public:
+    explicit archive_t(const std::string& path);
+
+    [[nodiscard]] const std::vector<member_t>& members() const {
+        return members_;
+    }
+    [[nodiscard]] const member_t& member(std::string_view name) const;
+    [[nodiscard]] std::string_view data(const member_t& member) const {
+        return input_.view().substr(member.offset, member.size);
+    }
+
+   private:
+    std::string path_;
+    sasi::fasta::input_buffer_t input_;
+    std::vector<member_t> members_;
+    std::unordered_map<std::string_view, size_t> lookup_;
+};
+
+bool is_tar(std::string_view type_ext);
+std::pair<std::string, std::string> split(const std::string& path);
+std::shared_ptr<const archive_t> open(const std::string& path);
+size_t input_size(const std::string& path);
+std::vector<std::string> expand(const std::vector<std::string>& inputs);
+
+}  // namespace sasi::tar
+#endif
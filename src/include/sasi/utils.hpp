@@ -9,6 +9,7 @@
 #include <iostream>
 #include <numeric>
 
+#include "histogram.hpp"
 #include "structs.hpp"
 
 namespace sasi {
@@ -19,8 +20,12 @@ namespace utils {
 
 void trim_whitespace(std::string& str);
 file_type_t extract_file_type(std::string path);
-int write_histogram(std::vector<size_t>& counts, bool zeros = false,
-                    const std::string& out_file = "-");
+CLI::Validator existing_input();
+int write_histogram(
+    const std::vector<size_t>& counts, bool zeros = false,
+    const std::string& out_file = "-",
+    sasi::hist::binning bins = sasi::hist::binning::exact, size_t width = 1);
+size_t thread_count(size_t requested);
 sasi::args_t set_cli_options(CLI::App& app);
 
 }  // namespace utils
@@ -0,0 +1,177 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sasi/dedup.hpp>
+#include <sasi/mask.hpp>
+#include <sasi/scheduler.hpp>
+#include <unordered_map>
+
+namespace sasi::dedup {
+
+namespace {
+constexpr std::uint64_t MUL_1{0x9e3779b97f4a7c15ULL};
+constexpr std::uint64_t MUL_2{0xff51afd7ed558ccdULL};
+// records hashed per task
+constexpr size_t HASH_BATCH{1024};
+
+std::uint64_t rotl(std::uint64_t x, unsigned r) {
+    return (x << r) | (x >> (64U - r));
+}
+
+// record i of data without gaps, through the gap mask of its hash batch
+std::string degapped(const std::vector<sasi::gap::mask_t>& gaps,
+                     const sasi::data_t& data, size_t i) {
+    std::string ret;
+    gaps[i / HASH_BATCH].degap(i, data.seqs[i], ret);
+    return ret;
+}
+}  // namespace
+
+/**
+ * @brief Fast non-cryptographic 64-bit hash of a sequence.
+ *
+ * @details Eight characters per multiply-rotate step, finished with the
+ * splitmix64 mixer. Equal hashes are confirmed by comparing sequences.
+ */
+std::uint64_t hash(std::string_view seq) {
+    std::uint64_t h = seq.size() * MUL_1;
+    size_t i{0};
+    for(; i + 8 <= seq.size(); i += 8) {
+        std::uint64_t word{0};
+        std::memcpy(&word, seq.data() + i, 8);
+        h = rotl(h ^ (word * MUL_2), 31U) * MUL_1;
+    }
+    std::uint64_t tail{0};
+    std::memcpy(&tail, seq.data() + i, seq.size() - i);
+    h = rotl(h ^ (tail * MUL_2), 31U) * MUL_1;
+    h = (h ^ (h >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27U)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31U);
+}
+
+/**
+ * @brief Groups of identical sequences of data.
+ *
+ * @details Records are hashed on `threads` workers, then records with equal
+ * hashes are compared. With `degap`, gaps are ignored.
+ *
+ * @return std::vector<std::vector<size_t>> record indices of every group
+ * with more than one record, ordered by their first record.
+ */
+std::vector<std::vector<size_t>> groups(const sasi::data_t& data, bool degap,
+                                        size_t threads) {
+    size_t n = data.seqs.size();
+    std::vector<std::uint64_t> hashes(n);
+    // gap masks of each hash batch, kept for the comparisons
+    std::vector<sasi::gap::mask_t> gaps(degap ? (n + HASH_BATCH - 1) /
+                                                    HASH_BATCH
+                                              : 0);
+    sasi::sched::pool_t pool(threads);
+    for(size_t first = 0; first < n; first += HASH_BATCH) {
+        pool.push(first / HASH_BATCH, [&, first](size_t /*worker*/) {
+            size_t last = std::min(n, first + HASH_BATCH);
+            if(degap) {
+                gaps[first / HASH_BATCH] = sasi::gap::mask_t(data, first, last);
+            }
+            for(size_t i = first; i < last; ++i) {
+                hashes[i] = degap ? hash(degapped(gaps, data, i))
+                                  : hash(data.seqs[i]);
+            }
+        });
+    }
+    pool.run();
+
+    auto same = [&](size_t a, size_t b) {
+        return degap ? degapped(gaps, data, a) == degapped(gaps, data, b)
+                     : data.seqs[a] == data.seqs[b];
+    };
+    // hash -> indices into ret of the groups with that hash
+    std::unordered_map<std::uint64_t, std::vector<size_t>> buckets;
+    buckets.reserve(n);
+    std::vector<std::vector<size_t>> ret;
+    for(size_t i = 0; i < n; ++i) {
+        auto& bucket = buckets[hashes[i]];
+        auto group = std::find_if(bucket.begin(), bucket.end(), [&](size_t g) {
+            return same(ret[g][0], i);
+        });
+        if(group == bucket.end()) {
+            bucket.push_back(ret.size());
+            ret.push_back({i});
+        } else {
+            ret[*group].push_back(i);
+        }
+    }
+    ret.erase(std::remove_if(ret.begin(), ret.end(),
+                             [](const auto& g) { return g.size() < 2; }),
+              ret.end());
+    return ret;
+}
+
+/**
+ * @brief Keep only the first of identical records when `args.dedup` is set.
+ */
+void records(sasi::data_t& data, const sasi::args_t& args, size_t threads) {
+    if(!args.dedup) {
+        return;
+    }
+    std::vector<bool> drop(data.seqs.size(), false);
+    for(const auto& group : groups(data, args.discard_gaps, threads)) {
+        for(size_t k = 1; k < group.size(); ++k) {
+            drop[group[k]] = true;
+        }
+    }
+    size_t kept{0};
+    for(size_t i = 0; i < data.seqs.size(); ++i) {
+        if(!drop[i]) {
+            if(kept != i) {
+                data.move_record(i, kept);
+            }
+            kept++;
+        }
+    }
+    data.truncate(kept);
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("dedup") {
+    CHECK(hash("ACGT") == hash(std::string{"ACGT"}));
+    CHECK(hash("ACGT") != hash("ACGA"));
+    CHECK(hash("ACGTACGTA") != hash("ACGTACGT"));
+    CHECK(hash("") != hash("A"));
+
+    sasi::data_t data("test.fa", {"1", "2", "3", "4", "5", "6"},
+                      {"ACGT", "AC-GT", "ACGT", "TTTT", "A-CGT", "ACGT-"});
+    std::vector<std::vector<size_t>> expected{{0, 2}};
+    CHECK(groups(data) == expected);
+    expected = {{0, 1, 2, 4, 5}};
+    CHECK(groups(data, true, 2) == expected);
+
+    // many records over several hash tasks
+    sasi::data_t many("many.fa");
+    for(size_t i = 0; i < 3000; ++i) {
+        many.names.push_back(std::to_string(i));
+        many.seqs.push_back(std::string(i % 7 + 1, 'A'));
+    }
+    auto many_groups = groups(many, false, 3);
+    REQUIRE(many_groups.size() == 7);
+    CHECK(many_groups[3].front() == 3);
+    CHECK(many_groups[3].size() == 429);
+
+    sasi::args_t args;
+    args.dedup = true;
+    records(data, args);
+    CHECK(data.names == std::vector<std::string>{"1", "2", "4", "5", "6"});
+    // records keep their index in the file
+    CHECK(data.ids == std::vector<size_t>{0, 1, 3, 4, 5});
+    args.discard_gaps = true;
+    records(data, args);
+    CHECK(data.names == std::vector<std::string>{"1", "4"});
+    CHECK(data.id(1) == 3);
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::dedup
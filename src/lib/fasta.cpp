@@ -2,35 +2,129 @@
 
 #include <doctest.h>
 
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <exception>
 #include <filesystem>
+#include <iterator>
+#include <sasi/dedup.hpp>
 #include <sasi/fasta.hpp>
+#include <sasi/fastq.hpp>
+#include <sasi/mask.hpp>
+#include <sasi/msa.hpp>
+#include <sasi/phylip.hpp>
+#include <sasi/sample.hpp>
+#include <sasi/tar.hpp>
+#include <thread>
 
-namespace sasi::fasta {
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
-sasi::data_t read_fasta(const std::string& f_path, bool ignore) {
-    sasi::data_t fasta(f_path);
+#include <cerrno>
+#include <climits>
+#define SASI_MMAP 1
+#endif
 
-    // set input pointer and file type
-    std::istream* pin(nullptr);
-    std::ifstream infile;  // input file
-    sasi::file_type_t in_type = sasi::utils::extract_file_type(f_path);
-    if(in_type.path.empty() || in_type.path == "-") {
-        pin = &std::cin;  // set to stdin
-        in_type.path = "-";
-    } else {
-        infile.open(f_path);
-        if(!infile || !infile.good()) {
-            throw std::invalid_argument("Opening input file " + f_path +
+namespace sasi::fasta {
+
+/**
+ * @brief Map path, or read it whole when it is stdin ("-" or empty) or
+ * cannot be mapped (pipes, devices).
+ */
+input_buffer_t::input_buffer_t(const std::string& path) {
+    if(path.empty() || path == "-") {
+        buffer_.assign(std::istreambuf_iterator<char>(std::cin),
+                       std::istreambuf_iterator<char>());
+        view_ = buffer_;
+        return;
+    }
+#if defined(SASI_MMAP)
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    struct stat st {};
+    if(fd_ == -1 || fstat(fd_, &st) != 0 || S_ISDIR(st.st_mode)) {
+        throw std::invalid_argument("Opening input file " + path +
+                                    " failed.");
+    }
+    if(!S_ISREG(st.st_mode)) {  // pipes and devices cannot be mapped
+        std::array<char, 1 << 16> chunk{};
+        ssize_t n{0};
+        while((n = ::read(fd_, chunk.data(), chunk.size())) > 0) {
+            buffer_.append(chunk.data(), static_cast<size_t>(n));
+        }
+        view_ = buffer_;
+        return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if(size_ > 0) {
+        map_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if(map_ == MAP_FAILED) {
+            map_ = nullptr;
+            throw std::invalid_argument("Reading input file " + path +
                                         " failed.");
         }
-        pin = &infile;  // set to file
-        in_type = sasi::utils::extract_file_type(f_path);
+        madvise(map_, size_, MADV_SEQUENTIAL);
+        view_ = std::string_view{static_cast<const char*>(map_), size_};
+    }
+#else
+    std::ifstream infile(path, std::ios::binary);
+    if(!infile || !infile.good()) {
+        throw std::invalid_argument("Opening input file " + path +
+                                    " failed.");
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(infile),
+                   std::istreambuf_iterator<char>());
+    view_ = buffer_;
+#endif
+}
+
+input_buffer_t::~input_buffer_t() {
+#if defined(SASI_MMAP)
+    if(map_ != nullptr) {
+        munmap(map_, size_);
+    }
+    if(fd_ != -1) {
+        ::close(fd_);
     }
-    std::istream& in = *pin;
+#endif
+}
+
+namespace {
+
+/**
+ * @brief Parse the records of one byte range.
+ *
+ * @details Same rules as a line by line read: empty and ';' lines are
+ * omitted, whitespace inside sequences is removed and a name without
+ * sequence is dropped. A range that is not the last one is closed as if
+ * the next line were a header, which is how the next range starts.
+ */
+void parse_range(std::string_view buffer, sasi::data_t& fasta, bool last) {
+    std::string name, content;
+    auto finish_record = [&]() {
+        if(!name.empty()) {
+            if(content.empty()) {  // If we have a name with no seq, remove
+                fasta.names.pop_back();
+            } else {
+                fasta.seqs.push_back(std::move(content));
+                name.clear();
+            }
+        }
+        content.clear();
+    };
 
-    std::string line, name, content;
-    while(in.good()) {
-        getline(in, line);
+    size_t pos{0};
+    while(pos < buffer.size()) {
+        size_t eol = buffer.find('\n', pos);
+        if(eol == std::string_view::npos) {
+            eol = buffer.size();
+        }
+        std::string_view line = buffer.substr(pos, eol - pos);
+        pos = eol + 1;
         if(line.empty()) {
             continue;  // omit empty lines
         }
@@ -38,26 +132,178 @@ sasi::data_t read_fasta(const std::string& f_path, bool ignore) {
             continue;
         }
         if(line[0] == '>') {  // Identifier marker
-            if(!name.empty()) {
-                if(content.empty()) {  // If we have a name with no seq, remove
-                    fasta.names.pop_back();
-                } else {
-                    fasta.seqs.push_back(content);
-                    name.clear();
-                }
-            }
+            finish_record();
             // Add name of sequence
             name = line.substr(1);
             fasta.names.push_back(name);
-            content.clear();
             continue;
         }
-        // Remove spaces
-        line.erase(remove_if(line.begin(), line.end(), ::isspace), line.end());
-        content += line;
+        // Append line without spaces
+        size_t start = content.size();
+        content.append(line);
+        auto first = content.begin() + static_cast<std::ptrdiff_t>(start);
+        content.erase(std::remove_if(first, content.end(),
+                                     [](unsigned char c) {
+                                         return std::isspace(c) != 0;
+                                     }),
+                      content.end());
+    }
+    if(last) {
+        if(!content.empty()) {
+            fasta.seqs.push_back(std::move(content));  // Add last sequence
+        }
+    } else {
+        finish_record();
     }
-    if(!content.empty()) {
-        fasta.seqs.push_back(content);  // Add last sequence if needed
+}
+}  // namespace
+
+/**
+ * @brief Parse FASTA records from a buffer.
+ *
+ * @details With more than one thread the buffer is cut into equal byte
+ * ranges, each moved forward to the next "\n>" so ranges start on a
+ * header, and ranges are parsed concurrently. Records are appended to
+ * `fasta` in file order.
+ */
+void parse_fasta(std::string_view buffer, sasi::data_t& fasta,
+                 size_t threads) {
+    if(threads <= 1 || buffer.size() < threads) {
+        parse_range(buffer, fasta, true);
+        return;
+    }
+
+    // range boundaries resynchronised to the start of a header line
+    std::vector<size_t> bounds{0};
+    for(size_t i = 1; i < threads; ++i) {
+        size_t cut = buffer.size() / threads * i;
+        cut = std::max(cut, bounds.back());
+        size_t next = buffer.find("\n>", cut == 0 ? 0 : cut - 1);
+        if(next == std::string_view::npos) {
+            break;
+        }
+        if(next + 1 > bounds.back()) {
+            bounds.push_back(next + 1);
+        }
+    }
+    bounds.push_back(buffer.size());
+
+    size_t n_ranges = bounds.size() - 1;
+    std::vector<sasi::data_t> parts(n_ranges);
+    std::vector<std::exception_ptr> errors(n_ranges);
+    auto work = [&](size_t i) {
+        try {
+            parse_range(buffer.substr(bounds[i], bounds[i + 1] - bounds[i]),
+                        parts[i], i + 1 == n_ranges);
+        } catch(...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(n_ranges - 1);
+    for(size_t i = 1; i < n_ranges; ++i) {
+        pool.emplace_back(work, i);
+    }
+    work(0);
+    for(auto& thread : pool) {
+        thread.join();
+    }
+    for(const auto& error : errors) {
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // stitch ranges back in record order
+    size_t n_names{fasta.names.size()}, n_seqs{fasta.seqs.size()};
+    for(const auto& part : parts) {
+        n_names += part.names.size();
+        n_seqs += part.seqs.size();
+    }
+    fasta.names.reserve(n_names);
+    fasta.seqs.reserve(n_seqs);
+    for(auto& part : parts) {
+        std::move(part.names.begin(), part.names.end(),
+                  std::back_inserter(fasta.names));
+        std::move(part.seqs.begin(), part.seqs.end(),
+                  std::back_inserter(fasta.seqs));
+    }
+}
+
+namespace {
+// parse buffer with the reader of extension type_ext
+void parse_input(std::string_view buffer, std::string_view type_ext,
+                 sasi::data_t& fasta, size_t threads, bool qualities) {
+    switch(sasi::msa::input_format(type_ext)) {
+    case sasi::msa::format::phylip:
+        sasi::phylip::parse_phylip(buffer, fasta);
+        break;
+    case sasi::msa::format::stockholm:
+        sasi::msa::parse_stockholm(buffer, fasta);
+        break;
+    case sasi::msa::format::clustal:
+        sasi::msa::parse_clustal(buffer, fasta);
+        break;
+    case sasi::msa::format::a3m:
+        sasi::msa::parse_a3m(buffer, fasta);
+        break;
+    case sasi::msa::format::fastq:
+        sasi::fastq::parse_fastq(buffer, fasta, qualities);
+        break;
+    default:
+        threads = sasi::utils::thread_count(threads);
+        if(buffer.size() < PARALLEL_PARSE_MIN) {
+            threads = 1;
+        }
+        parse_fasta(buffer, fasta, threads);
+    }
+}
+}  // namespace
+
+/**
+ * @brief Read a FASTA file, or a PHYLIP, Stockholm, Clustal, A2M/A3M or
+ * FASTQ file selected by its extension or "ext:" prefix
+ * (`msa::input_format`).
+ *
+ * @details FASTA inputs of at least `PARALLEL_PARSE_MIN` bytes are parsed
+ * with `threads` threads (0 = all cores). FASTQ qualities are kept only
+ * if `qualities` is set, and every record must then have them.
+ * "tar:archive:member" reads one member of a tar
+ * archive and "tar:archive" all of them, each with the reader of its own
+ * extension, straight from the mapped archive.
+ */
+sasi::data_t read_fasta(const std::string& f_path, bool ignore,
+                        size_t threads, bool qualities) {
+    sasi::data_t fasta(f_path);
+    sasi::profile::scope prof{"parse", f_path};
+
+    // set input path and file type ("-" or empty is stdin)
+    sasi::file_type_t in_type = sasi::utils::extract_file_type(f_path);
+    if(in_type.path.empty()) {
+        in_type.path = "-";
+    }
+    size_t bytes{0};
+    if(sasi::tar::is_tar(in_type.type_ext)) {
+        auto [archive_path, name] = sasi::tar::split(in_type.path);
+        auto archive = sasi::tar::open(archive_path);
+        auto parse_member = [&](const sasi::tar::member_t& member) {
+            std::string_view buffer = archive->data(member);
+            parse_input(buffer,
+                        std::filesystem::path(member.name).extension().string(),
+                        fasta, threads, qualities);
+            bytes += buffer.size();
+        };
+        if(name.empty()) {
+            for(const auto& member : archive->members()) {
+                parse_member(member);
+            }
+        } else {
+            parse_member(archive->member(name));
+        }
+    } else {
+        input_buffer_t input(in_type.path);
+        parse_input(input.view(), in_type.type_ext, fasta, threads, qualities);
+        bytes = input.view().size();
     }
 
     if(fasta.seqs.size() == 0 && !ignore) {
@@ -69,9 +315,247 @@ sasi::data_t read_fasta(const std::string& f_path, bool ignore) {
             "Different number of sequences and names in " + f_path + ".");
     }
 
+    // low quality bases (-q) are only counted on FASTQ records
+    if(qualities && fasta.quals.size() != fasta.seqs.size()) {
+        throw std::invalid_argument("Input file " + f_path +
+                                    " has no qualities for --min-quality.");
+    }
+
+    fasta.records = fasta.seqs.size();
+    prof.add(bytes, fasta.seqs.size());
     return fasta;
 }
 
+/**
+ * @brief Drop duplicate records (`--dedup`), then sample records
+ * (`--sample-fraction`, `--sample-records`), then drop the columns left
+ * all-gap by the remaining records (`--drop-gap-columns`).
+ */
+void select_records(sasi::data_t& fasta, const sasi::args_t& args,
+                    size_t threads) {
+    sasi::dedup::records(fasta, args, threads);
+    sasi::sample::records(fasta, args);
+    if(args.drop_gap_columns) {
+        sasi::gap::drop_gap_columns(fasta, threads);
+    }
+}
+
+/**
+ * @brief Read a fasta file with the input options of args.
+ */
+sasi::data_t read_fasta(const std::string& f_path, const sasi::args_t& args) {
+    sasi::data_t fasta = read_fasta(f_path, args.ignore_empty, args.threads,
+                                    args.min_quality > 0);
+    select_records(fasta, args, sasi::utils::thread_count(args.threads));
+    return fasta;
+}
+
+namespace {
+constexpr std::string_view HEADER{">"};
+constexpr std::string_view NEWLINE{"\n"};
+// views queued before an automatic flush
+constexpr size_t WRITER_PIECES{4096};
+}  // namespace
+
+/**
+ * @brief Open path for writing; "-" or empty is stdout.
+ */
+writer_t::writer_t(const std::string& path, size_t line_width)
+    : width_{line_width} {
+    pieces_.reserve(WRITER_PIECES);
+    bool stdout_path = path.empty() || path == "-";
+    // keep anything already written through std::cout in order
+    std::cout.flush();
+#if defined(SASI_MMAP)
+    if(stdout_path) {
+        fd_ = STDOUT_FILENO;
+        return;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd_ == -1) {
+        throw std::runtime_error("Opening output file " + path + " failed.");
+    }
+    own_ = true;
+#else
+    if(!stdout_path) {
+        file_.open(path, std::ios::binary);
+        if(!file_) {
+            throw std::runtime_error("Opening output file " + path +
+                                     " failed.");
+        }
+        own_ = true;
+    }
+#endif
+}
+
+writer_t::~writer_t() {
+    try {
+        flush();
+    } catch(...) {  // NOLINT(bugprone-empty-catch): call flush() to see errors
+    }
+#if defined(SASI_MMAP)
+    if(own_) {
+        ::close(fd_);
+    }
+#endif
+}
+
+/**
+ * @brief Queue one record. name and seq must outlive the next flush.
+ */
+void writer_t::write(std::string_view name, std::string_view seq) {
+    if(pieces_.size() + 4 + (width_ > 0 ? 2 * seq.size() / width_ : 0) >
+       WRITER_PIECES) {
+        flush();
+    }
+    pieces_.push_back(HEADER);
+    pieces_.push_back(name);
+    pieces_.push_back(NEWLINE);
+    if(width_ == 0 || seq.size() <= width_) {
+        pieces_.push_back(seq);
+        pieces_.push_back(NEWLINE);
+        return;
+    }
+    for(size_t pos = 0; pos < seq.size(); pos += width_) {
+        pieces_.push_back(seq.substr(pos, width_));
+        pieces_.push_back(NEWLINE);
+        if(pieces_.size() >= WRITER_PIECES) {
+            flush();
+        }
+    }
+}
+
+/**
+ * @brief Write the records of fasta whose keep flag is set (all if keep is
+ * empty), then flush.
+ */
+void writer_t::write(const sasi::data_t& fasta, const std::vector<char>& keep) {
+    for(size_t i = 0; i < fasta.seqs.size(); ++i) {
+        if(keep.empty() || keep[i] != 0) {
+            write(fasta.names[i], fasta.seqs[i]);
+        }
+    }
+    flush();
+}
+
+/**
+ * @brief Write queued records.
+ *
+ * @throws std::runtime_error if writing fails.
+ */
+void writer_t::flush() {
+    if(pieces_.empty()) {
+        return;
+    }
+#if defined(SASI_MMAP)
+    std::vector<iovec> iov;
+    iov.reserve(std::min<size_t>(pieces_.size(), IOV_MAX));
+    size_t next{0};
+    while(next < pieces_.size()) {
+        iov.clear();
+        for(; next < pieces_.size() && iov.size() < IOV_MAX; ++next) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            iov.push_back(iovec{const_cast<char*>(pieces_[next].data()),
+                                pieces_[next].size()});
+        }
+        // writev may stop early: resume from the first unwritten byte
+        size_t first{0};
+        while(first < iov.size()) {
+            ssize_t n = ::writev(fd_, &iov[first],
+                                 static_cast<int>(iov.size() - first));
+            if(n < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                pieces_.clear();
+                throw std::runtime_error(
+                    std::string{"Writing output failed: "} +
+                    std::strerror(errno));
+            }
+            auto left = static_cast<size_t>(n);
+            while(first < iov.size() && left >= iov[first].iov_len) {
+                left -= iov[first++].iov_len;
+            }
+            if(left > 0) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) +
+                                      left;
+                iov[first].iov_len -= left;
+            }
+        }
+    }
+#else
+    std::ostream& out = own_ ? static_cast<std::ostream&>(file_) : std::cout;
+    for(const auto& piece : pieces_) {
+        out.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+    }
+    out.flush();
+    if(!out) {
+        pieces_.clear();
+        throw std::runtime_error("Writing output failed.");
+    }
+#endif
+    pieces_.clear();
+}
+
+/**
+ * @brief Write all records of fasta to out_file ("-" is stdout).
+ *
+ * @return false if the file cannot be opened or written.
+ */
+bool write_fasta(const sasi::data_t& fasta, const std::string& out_file,
+                 size_t line_width) {
+    try {
+        writer_t writer(out_file, line_width);
+        writer.write(fasta);
+    } catch(const std::runtime_error&) {
+        return false;
+    }
+    return true;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("write_fasta") {
+    sasi::data_t fasta("in.fa", {"a", "b", "c"}, {"ACGTACGTAC", "T", "AC-"});
+    auto slurp = [](const std::string& path) {
+        std::ifstream in(path);
+        return std::string{std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>()};
+    };
+    SUBCASE("one line per sequence") {
+        REQUIRE(write_fasta(fasta, "test-write.fa"));
+        CHECK(slurp("test-write.fa") ==
+              ">a\nACGTACGTAC\n>b\nT\n>c\nAC-\n");
+        // round trip
+        sasi::data_t back = read_fasta("test-write.fa");
+        CHECK(back.names == fasta.names);
+        CHECK(back.seqs == fasta.seqs);
+    }
+    SUBCASE("wrapped lines") {
+        REQUIRE(write_fasta(fasta, "test-write.fa", 4));
+        CHECK(slurp("test-write.fa") ==
+              ">a\nACGT\nACGT\nAC\n>b\nT\n>c\nAC-\n");
+        CHECK(read_fasta("test-write.fa").seqs == fasta.seqs);
+    }
+    SUBCASE("selected records and many pieces") {
+        {
+            writer_t writer("test-write.fa", 1);
+            writer.write(fasta, {1, 0, 1});
+            std::string big(WRITER_PIECES * 3, 'T');
+            writer.write("big", big);
+            writer.flush();
+        }
+        std::string text = slurp("test-write.fa");
+        CHECK(text.rfind(">a\nA\nC\nG\n", 0) == 0);
+        CHECK(text.find(">b\n") == std::string::npos);
+        CHECK(text.size() == 3 + 20 + 3 + 6 + 5 + WRITER_PIECES * 3 * 2);
+    }
+    REQUIRE(std::filesystem::remove("test-write.fa"));
+    CHECK_FALSE(write_fasta(fasta, "no-such-dir/test.fa"));
+}
+// GCOVR_EXCL_STOP
+
 /// @private
 // GCOVR_EXCL_START
 TEST_CASE("read_fasta") {
@@ -136,6 +620,16 @@ TEST_CASE("read_fasta") {
                         std::invalid_argument);
         REQUIRE(std::filesystem::remove("test-seq.fasta"));
     }
+    SUBCASE("Qualities of a FASTA file") {
+        std::ofstream out;
+        out.open("test-seq.fasta");
+        REQUIRE(out);
+        out << ">1\nACGT\n";
+        out.close();
+        CHECK_THROWS_AS(read_fasta("test-seq.fasta", false, 1, true),
+                        std::invalid_argument);
+        REQUIRE(std::filesystem::remove("test-seq.fasta"));
+    }
     SUBCASE("Diff number of names and sequences") {
         std::ofstream out;
         out.open("test-seq.fasta");
@@ -145,6 +639,29 @@ TEST_CASE("read_fasta") {
         CHECK_THROWS_AS(read_fasta("test-seq.fasta"), std::invalid_argument);
         REQUIRE(std::filesystem::remove("test-seq.fasta"));
     }
+    SUBCASE("Parallel parse matches serial parse") {
+        std::string buffer{"; comment line\nAC\n"};
+        for(size_t i = 0; i < 200; ++i) {
+            buffer += ">seq" + std::to_string(i) + "\n";
+            if(i % 17 == 0) {
+                continue;  // name without sequence
+            }
+            if(i % 5 == 0) {
+                buffer += "\n; comment\n";
+            }
+            buffer += std::string(i % 13 + 1, "ACGT-"[i % 5]) + "\n";
+            buffer += "AC GT\tNN\r\n";
+        }
+        sasi::data_t serial;
+        parse_fasta(buffer, serial, 1);
+        REQUIRE(serial.names.size() == serial.seqs.size());
+        for(size_t threads : {2, 3, 7, 64, 5000}) {
+            sasi::data_t parallel;
+            parse_fasta(buffer, parallel, threads);
+            CHECK(parallel.names == serial.names);
+            CHECK(parallel.seqs == serial.seqs);
+        }
+    }
     SUBCASE("Empty file") {
         std::ofstream out;
         out.open("test-empty.fasta");
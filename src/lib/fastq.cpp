@@ -0,0 +1,210 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <sasi/fasta.hpp>
+#include <sasi/fastq.hpp>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sasi::fastq {
+
+namespace {
+size_t popcount(std::uint32_t x) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcount(x));
+#else
+    return std::bitset<32>(x).count();
+#endif
+}
+
+// line starting at pos without its trailing '\r'; pos moves past it
+std::string_view next_line(std::string_view buffer, size_t& pos) {
+    size_t eol = buffer.find('\n', pos);
+    if(eol == std::string_view::npos) {
+        eol = buffer.size();
+    }
+    std::string_view line = buffer.substr(pos, eol - pos);
+    pos = eol + 1;
+    if(!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+}  // namespace
+
+/**
+ * @brief Parse four-line FASTQ records ("@name", sequence, "+", quality).
+ *
+ * @details Every record is exactly four lines, so lines are taken by
+ * position without looking at their content beyond the first character.
+ * The quality line is only checked for length and is copied into
+ * `fastq.quals` only when `qualities` is set. Blank lines between records
+ * are ignored. Multi-line FASTQ is not supported.
+ *
+ * @throws std::invalid_argument if a record is truncated, lacks its '@' or
+ * '+' line, or its quality length differs from its sequence length.
+ */
+void parse_fastq(std::string_view buffer, sasi::data_t& fastq,
+                 bool qualities) {
+    const std::string file = fastq.path.string();
+    auto lines = std::count(buffer.begin(), buffer.end(), '\n');
+    size_t records = static_cast<size_t>(lines) / 4 + 1;
+    fastq.names.reserve(fastq.names.size() + records);
+    fastq.seqs.reserve(fastq.seqs.size() + records);
+    if(qualities) {
+        fastq.quals.reserve(fastq.quals.size() + records);
+    }
+
+    size_t pos{0};
+    while(pos < buffer.size()) {
+        std::string_view header = next_line(buffer, pos);
+        if(header.empty()) {
+            continue;
+        }
+        if(header[0] != '@') {
+            throw std::invalid_argument("Malformed FASTQ record in " + file +
+                                        ": expected '@', found \"" +
+                                        std::string{header} + "\".");
+        }
+        std::string_view name = header.substr(1);
+        if(pos >= buffer.size()) {
+            throw std::invalid_argument("Truncated FASTQ record " +
+                                        std::string{name} + " in " + file +
+                                        ".");
+        }
+        std::string_view seq = next_line(buffer, pos);
+        if(pos >= buffer.size() || buffer[pos] != '+') {
+            throw std::invalid_argument("FASTQ record " + std::string{name} +
+                                        " of " + file + " has no '+' line.");
+        }
+        next_line(buffer, pos);
+        std::string_view qual = next_line(buffer, pos);
+        if(qual.size() != seq.size()) {
+            throw std::invalid_argument(
+                "Quality and sequence lengths differ for FASTQ record " +
+                std::string{name} + " of " + file + ".");
+        }
+
+        fastq.names.emplace_back(name);
+        fastq.seqs.emplace_back(seq);
+        if(qualities) {
+            fastq.quals.emplace_back(qual);
+        }
+    }
+}
+
+/**
+ * @brief Number of bases with Phred quality below min_quality.
+ *
+ * @details Quality characters are compared against offset + min_quality
+ * 16 at a time with SSE2 when available (unsigned compare via a sign-bit
+ * flip) and the matches counted from the movemask.
+ *
+ * @param quals quality string of one record
+ * @param min_quality Phred threshold, 0 counts nothing
+ * @param offset quality encoding offset (33 or 64)
+ */
+size_t count_below(std::string_view quals, size_t min_quality,
+                   size_t offset) {
+    if(min_quality == 0) {
+        return 0;
+    }
+    size_t limit = offset + min_quality;
+    if(limit > UINT8_MAX) {
+        return quals.size();
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(quals.data());
+    size_t n = quals.size();
+    size_t low{0};
+    size_t i{0};
+#if defined(__SSE2__)
+    const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i threshold =
+        _mm_xor_si128(_mm_set1_epi8(static_cast<char>(limit)), sign);
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(bytes + i));  // NOLINT
+        auto m = static_cast<std::uint32_t>(_mm_movemask_epi8(
+            _mm_cmplt_epi8(_mm_xor_si128(v, sign), threshold)));
+        low += popcount(m);
+    }
+#endif
+    for(; i < n; ++i) {
+        low += static_cast<size_t>(bytes[i] < limit);
+    }
+    return low;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("fastq") {
+    auto parse = [](std::string_view text, bool qualities = false) {
+        sasi::data_t data("test.fq");
+        parse_fastq(text, data, qualities);
+        return data;
+    };
+    std::vector<std::string> names{"read1 lane=1", "read2"};
+    std::vector<std::string> seqs{"ACGTN", "GGNNA"};
+    std::string_view text{
+        "@read1 lane=1\nACGTN\n+\nII#5!\n\n@read2\r\nGGNNA\r\n+read2\r\n"
+        "\"\"III\r\n"};
+    SUBCASE("parse") {
+        auto data = parse(text);
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+        CHECK(data.quals.empty());
+        data = parse(text, true);
+        CHECK(data.seqs == seqs);
+        CHECK(data.quals == std::vector<std::string>{"II#5!", "\"\"III"});
+        CHECK(parse("@a\nAC\n+\nII").seqs == std::vector<std::string>{"AC"});
+        CHECK(parse("").names.empty());
+    }
+    SUBCASE("errors") {
+        CHECK_THROWS_AS(parse(">a\nACGT\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("@a\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("@a\nACGT\nIIII\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("@a\nACGT\n+\nIII\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("@a\nACGT\n+\nIIIII\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("@a\nACGT\n+\nIII\n\n@b\nA\n+\nI\n"),
+                        std::invalid_argument);
+    }
+    SUBCASE("count below") {
+        // '!' = 0, '#' = 2, '5' = 20, 'I' = 40
+        CHECK(count_below("II#5!", 0) == 0);
+        CHECK(count_below("II#5!", 20) == 2);
+        CHECK(count_below("II#5!", 21) == 3);
+        CHECK(count_below("II#5!", 41) == 5);
+        CHECK(count_below("hh", 20, 64) == 0);
+        CHECK(count_below("TT", 21, 64) == 2);
+        CHECK(count_below("II", 300) == 2);
+        std::string quals(100, 'I');
+        quals[3] = quals[17] = quals[64] = quals[99] = '#';
+        quals[40] = static_cast<char>(0xF0);
+        CHECK(count_below(quals, 30) == 4);
+        CHECK(count_below(quals, 200) == 99);
+    }
+    SUBCASE("read_fasta dispatch") {
+        std::ofstream out;
+        out.open("test-fastq.txt");
+        REQUIRE(out);
+        out << text;
+        out.close();
+        auto data = sasi::fasta::read_fasta("fq:test-fastq.txt");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+        CHECK(data.quals.empty());
+        data = sasi::fasta::read_fasta("fq:test-fastq.txt", false, 1, true);
+        CHECK(data.quals.size() == 2);
+        REQUIRE(std::filesystem::remove("test-fastq.txt"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::fastq
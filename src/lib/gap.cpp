@@ -2,68 +2,135 @@
 
 #include <doctest.h>
 
+#include <array>
+#include <cstdint>
+#include <map>
 #include <sasi/gap.hpp>
+#include <sasi/mask.hpp>
+#include <sasi/sample.hpp>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 
 namespace sasi::gap {
 
+namespace {
+// largest gap length unit with a compile-time specialisation
+constexpr size_t MAX_CONSTANT_K{12};
+// largest gap length unit of --k-range, one table row per unit
+constexpr size_t MAX_K_RANGE{100000};
+
+template <class F, size_t... K>
+bool dispatch_k(size_t k, F& f, std::index_sequence<K...> /*ks*/) {
+    return ((k == K + 1
+                 ? (f(std::integral_constant<size_t, K + 1>{}), true)
+                 : false) ||
+            ...);
+}
+
 /**
- * @brief Gap frequency.
+ * @brief Call f(k) with k as a compile-time constant for common values.
  *
- * @param[in] args sasi::args_t contains name of sequence files.
- *
- * @return std::vector<size_t> gap frequency vector - position is length and
- * value is count;
+ * @details `length % k` on an integral_constant compiles to a multiply and
+ * shift instead of a division; other values of k fall back to size_t.
  */
+template <class F>
+void with_constant_k(size_t k, F&& f) {
+    if(!dispatch_k(k, f, std::make_index_sequence<MAX_CONSTANT_K>{})) {
+        f(k);
+    }
+}
 
-std::vector<std::pair<size_t, size_t>> frequency(const sasi::args_t& args) {
-    // gap counts vector -  each position is the number of gaps with its length
-    // (e.g. value  at position 1 is number of gaps of size 1)
-    std::vector<size_t> counts;
+// relative position (%) of a gap starting at start of a sequence of length n
+size_t percent(size_t start, size_t n) {
+    return static_cast<size_t>(static_cast<float>(start) /
+                               static_cast<float>(n - 1) * 100);
+}
 
-    // for each fasta file in input
-    for(const auto& file : args.input) {
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
+void check_k_range(const sasi::args_t& args) {
+    if(args.k_range.size() != 2 || args.k_range[0] == 0 ||
+       args.k_range[0] > args.k_range[1] || args.k_range[1] > MAX_K_RANGE) {
+        throw std::invalid_argument(
+            "Gap length range must be 1 <= min <= max <= " +
+            std::to_string(MAX_K_RANGE) + ".");
+    }
+}
 
-        if(data.seqs.size() == 0 && args.ignore_empty) {
-            continue;
-        }
+// gap run of one file, the key of shared indels
+struct indel_key_t {
+    size_t file;
+    size_t start;
+    size_t length;
 
-        // if capacity of vector is smaller than size of aln, resize
-        if(counts.capacity() < data.len()) {
-            counts.resize(data.len() + 1);
-        }
+    bool operator==(const indel_key_t& o) const {
+        return file == o.file && start == o.start && length == o.length;
+    }
+};
 
-        // for each sequence find next gap starting at 0
-        // if we reach the end, next sequence
-        // otherwhise count the length of the gap
-        for(const std::string& seq : data.seqs) {
-            size_t pos{seq.find(GAP, 0)};
-            while(pos != std::string::npos) {
-                size_t lcount{0};
-                // add current gap count until a nucleotide is found
-                while(seq.at(pos) == GAP) {
-                    ++pos;
-                    ++lcount;
-                    if(pos >= seq.size()) {
-                        break;
-                    }
-                }
-                counts[lcount]++;
-                // look for next gap
-                pos = seq.find(GAP, pos + 1);
-            }
-        }
+struct indel_hash_t {
+    size_t operator()(const indel_key_t& key) const {
+        // 64-bit mix of the packed fields (splitmix64 finalizer)
+        std::uint64_t h = (std::uint64_t{key.start} << 24U) ^
+                          std::uint64_t{key.length} ^
+                          (std::uint64_t{key.file} << 48U);
+        h = (h ^ (h >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27U)) * 0x94d049bb133111ebULL;
+        return static_cast<size_t>(h ^ (h >> 31U));
     }
+};
+}  // namespace
 
-    // remove zero counts and create vector of pairs <length, count>
-    std::vector<std::pair<size_t, size_t>> freqs;
-    for(size_t i = 0; i < counts.size(); ++i) {
-        if(counts[i] > 0) {
-            freqs.emplace_back(i, counts[i]);
+/**
+ * @brief Histogram of gap lengths.
+ *
+ * @details Workers count into their own `hist::histogram_t`, so a few very
+ * long gaps take a map entry each instead of a count for every length.
+ *
+ * @param[in] args sasi::args_t contains name of sequence files.
+ *
+ * @return sasi::hist::histogram_t gap lengths of all input files.
+ */
+sasi::hist::histogram_t histogram(const sasi::args_t& args) {
+    using hist_t = sasi::hist::histogram_t;
+    hist_t hist;
+    // count every shared indel once per file
+    if(args.unique_indels) {
+        for(const auto& indel : indels(args)) {
+            hist.add(indel.length);
         }
+        return hist;
+    }
+    auto accs = sasi::sched::for_each_batch<hist_t>(
+        args, [&args](hist_t& counts, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"gap::frequency",
+                                      args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                batch.gaps().for_each_run(
+                    i, [&counts](size_t /*start*/, size_t length) {
+                        counts.add(length);
+                    });
+            }
+        });
+
+    // merge worker histograms
+    for(const auto& acc : accs) {
+        hist.merge(acc);
     }
+    return hist;
+}
 
-    return freqs;
+/**
+ * @brief Gap frequency.
+ *
+ * @param[in] args sasi::args_t contains name of sequence files.
+ *
+ * @return std::vector<std::pair<size_t, size_t>> (length, count) of every
+ * gap length present, in increasing length order.
+ */
+std::vector<std::pair<size_t, size_t>> frequency(const sasi::args_t& args) {
+    return histogram(args).counts();
 }
 
 /// @private
@@ -154,34 +221,28 @@ TEST_CASE("gap_frequency") {
 
 std::vector<size_t> position(const sasi::args_t& args) {
     // gap position vector
-    std::vector<size_t> gaps(101, 0);
-
-    for(const auto& file : args.input) {
-        // read fasta file
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
-
-        if(data.seqs.size() == 0 && args.ignore_empty) {
-            continue;
-        }
-
-        // find gaps on each sequence
-        for(const std::string& seq : data.seqs) {
-            size_t pos{0};
-            while(pos < seq.length()) {
-                // look for next gap
-                pos = seq.find(GAP, pos);
-                if(pos > seq.length()) {
-                    break;
-                }
-                // store current gap position
-                auto percentage = static_cast<float>(pos) /
-                                  static_cast<float>(seq.length() - 1) * 100;
-                ++gaps[static_cast<size_t>(percentage)];
-                // skip length of current gap (only beginning is reported)
-                while(pos < seq.length() && seq.at(pos) == GAP) {
-                    ++pos;
-                }
+    using gaps_t = std::vector<size_t>;
+    auto accs = sasi::sched::for_each_batch<gaps_t>(
+        args,
+        [&args](gaps_t& gaps, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"gap::position", args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            // find gaps on each sequence, only beginning is reported
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                std::string_view seq = batch.seq(i);
+                batch.gaps().for_each_run(
+                    i, [&gaps, &seq](size_t start, size_t) {
+                        ++gaps[percent(start, seq.length())];
+                    });
             }
+        },
+        true, gaps_t(101, 0));
+
+    // merge worker counts
+    gaps_t gaps(101, 0);
+    for(const auto& acc : accs) {
+        for(size_t i = 0; i < gaps.size(); ++i) {
+            gaps[i] += acc[i];
         }
     }
 
@@ -253,6 +314,7 @@ TEST_CASE("gap_position") {
  */
 std::pair<size_t, size_t> frameshift(
     const std::vector<std::pair<size_t, size_t>>& counts) {
+    sasi::profile::scope prof{"gap::frameshift"};
     std::pair<size_t, size_t> total{0, 0};  // total_frameshifts, total_gaps
     if(any_of(counts.begin(), counts.end(), [](std::pair<size_t, size_t> pair) {
            return pair.second <= 0;
@@ -311,41 +373,46 @@ TEST_CASE("gap_frameshift") {
  * 1, and 2.
  */
 std::vector<std::vector<size_t>> phase(const sasi::args_t& args) {
-    // phase counts vector
-    std::vector<std::vector<size_t>> phases;
-
-    // for each fasta file in input
-    for(const auto& file : args.input) {
-        std::vector<size_t> phase{0, 0, 0};
-        // read fasta file
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
-
-        if(data.seqs.size() == 0 && args.ignore_empty) {
-            continue;
-        }
-
-        // find gaps on each sequence
-        for(const std::string& seq : data.seqs) {
-            size_t pos{seq.find(GAP, 0)};
-            size_t npos{0};
-            while(pos < seq.length()) {
-                npos = seq.find_first_not_of(GAP, pos + 1);
-                if(npos > seq.length()) {
-                    break;
-                } else if((npos - pos) % args.k == 0) {
-                    phase[pos % 3]++;
+    // phase counts per input file, files not read are left empty
+    using phases_t = std::vector<std::vector<size_t>>;
+    size_t k = args.k;
+    auto accs = sasi::sched::for_each_batch<phases_t>(
+        args,
+        [&args, k](phases_t& phases, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"gap::phase", args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            std::vector<size_t>& phase = phases[batch.file];
+            phase.resize(3, 0);
+            // gaps of length multiple of k by phase of their first position
+            with_constant_k(k, [&phase, &batch](auto unit) {
+                for(size_t i = batch.first; i < batch.last; ++i) {
+                    batch.gaps().for_each_run(
+                        i, [&phase, unit](size_t start, size_t length) {
+                            if(length % unit == 0) {
+                                phase[start % 3]++;
+                            }
+                        });
                 }
-                // look for next gap
-                pos = seq.find(GAP, npos + 1);
+            });
+        },
+        true, phases_t(args.input.size()));
+
+    // merge worker counts, keeping input order
+    phases_t phases;
+    for(size_t file = 0; file < args.input.size(); ++file) {
+        std::vector<size_t> phase;
+        for(const auto& acc : accs) {
+            if(acc[file].empty()) {
+                continue;
             }
-            // handle all seq is gap
-            if(pos < seq.length()) {
-                if((seq.length() - pos) % args.k == 0) {
-                    phase[pos % 3]++;
-                }
+            phase.resize(3, 0);
+            for(size_t i = 0; i < 3; ++i) {
+                phase[i] += acc[file][i];
             }
         }
-        phases.push_back(phase);
+        if(!phase.empty()) {
+            phases.push_back(phase);
+        }
     }
 
     return phases;
@@ -420,4 +487,744 @@ TEST_CASE("gap_phase") {
     }
 }
 // GCOVR_EXCL_STOP
+
+/**
+ * @brief Gap phases for every gap length unit k in a range, in one scan.
+ *
+ * @details Gaps are first counted by length and phase of their first
+ * position. The count for unit k is then the sum over lengths k, 2k, 3k...
+ * so no modulo is computed per gap.
+ *
+ * @return std::vector<std::vector<size_t>> one row {phase0, phase1, phase2}
+ * per k from `args.k_range[0]` to `args.k_range[1]`, over all input files.
+ */
+std::vector<std::vector<size_t>> phase_range(const sasi::args_t& args) {
+    check_k_range(args);
+
+    // counts[length][phase]
+    using hist_t = std::vector<std::array<size_t, 3>>;
+    auto accs = sasi::sched::for_each_batch<hist_t>(
+        args, [&args](hist_t& hist, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"gap::phase_range",
+                                      args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                std::string_view seq = batch.seq(i);
+                if(hist.size() <= seq.size()) {
+                    hist.resize(seq.size() + 1, {0, 0, 0});
+                }
+                batch.gaps().for_each_run(
+                    i, [&hist](size_t start, size_t length) {
+                        hist[length][start % 3]++;
+                    });
+            }
+        });
+
+    // merge worker counts
+    hist_t hist;
+    for(const auto& acc : accs) {
+        if(hist.size() < acc.size()) {
+            hist.resize(acc.size(), {0, 0, 0});
+        }
+        for(size_t len = 0; len < acc.size(); ++len) {
+            for(size_t p = 0; p < 3; ++p) {
+                hist[len][p] += acc[len][p];
+            }
+        }
+    }
+
+    std::vector<std::vector<size_t>> table;
+    table.reserve(args.k_range[1] - args.k_range[0] + 1);
+    for(size_t k = args.k_range[0]; k <= args.k_range[1]; ++k) {
+        std::vector<size_t> row{0, 0, 0};
+        for(size_t len = k; len < hist.size(); len += k) {
+            for(size_t p = 0; p < 3; ++p) {
+                row[p] += hist[len][p];
+            }
+        }
+        table.push_back(row);
+    }
+    return table;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_phase_range") {
+    std::vector<std::string> files{"test-krange-1.fa", "test-krange-2.fa"};
+    std::ofstream out;
+    out.open(files[0]);
+    REQUIRE(out);
+    out << ">1\nAA- -A- --A --- --- --- -AA\n>2\n--- --A ---- A-A\n";
+    out.close();
+    out.open(files[1]);
+    REQUIRE(out);
+    out << ">1\nAA- -AC CCA --- T-- --G -AA ------- ---------- ------A\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = files;
+    args.k_range = {1, 14};
+    auto table = phase_range(args);
+    REQUIRE(table.size() == 14);
+    // each row equals a single-k phase run summed over files
+    for(size_t k = 1; k <= 14; ++k) {
+        args.k = k;
+        std::vector<size_t> expected{0, 0, 0};
+        for(const auto& file_phase : phase(args)) {
+            for(size_t p = 0; p < 3; ++p) {
+                expected[p] += file_phase[p];
+            }
+        }
+        CHECK_EQ(table[k - 1], expected);
+    }
+
+    args.k_range = {3, 3};
+    CHECK_EQ(phase_range(args).size(), 1);
+    args.k_range = {0, 3};
+    CHECK_THROWS_AS(phase_range(args), std::invalid_argument);
+    args.k_range = {4, 3};
+    CHECK_THROWS_AS(phase_range(args), std::invalid_argument);
+    args.k_range = {1, 100000000000};
+    CHECK_THROWS_AS(phase_range(args), std::invalid_argument);
+
+    for(const auto& file : files) {
+        REQUIRE(std::filesystem::remove(file));
+    }
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Joint histogram of gap length, phase and relative position.
+ *
+ * @details One scan over the gap runs; each gap is keyed by its length,
+ * the phase of its first position and the bin (of `args.bin_width` percent)
+ * of its relative position, as computed by `position`. Only non-empty
+ * cells are stored, packed into one 64-bit key.
+ *
+ * @return std::vector<sasi::gap_cell_t> non-empty cells sorted by length,
+ * phase and position.
+ */
+std::vector<sasi::gap_cell_t> joint(const sasi::args_t& args) {
+    if(args.bin_width == 0 || args.bin_width > 101) {
+        throw std::invalid_argument("Bin width must be between 1 and 101.");
+    }
+    // key = length << 16 | phase << 8 | bin
+    using hist_t = std::unordered_map<std::uint64_t, size_t>;
+    auto accs = sasi::sched::for_each_batch<hist_t>(
+        args, [&args](hist_t& hist, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"gap::joint", args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            std::uint64_t width = args.bin_width;
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                std::string_view seq = batch.seq(i);
+                batch.gaps().for_each_run(i, [&](size_t start, size_t length) {
+                    std::uint64_t bin = percent(start, seq.length()) / width;
+                    std::uint64_t key = (std::uint64_t{length} << 16U) |
+                                        ((start % 3) << 8U) | bin;
+                    hist[key]++;
+                });
+            }
+        });
+
+    // merge worker histograms
+    hist_t hist = std::move(accs[0]);
+    for(size_t w = 1; w < accs.size(); ++w) {
+        for(const auto& [key, count] : accs[w]) {
+            hist[key] += count;
+        }
+    }
+
+    std::vector<std::pair<std::uint64_t, size_t>> cells(hist.begin(),
+                                                        hist.end());
+    std::sort(cells.begin(), cells.end());
+    std::vector<sasi::gap_cell_t> ret;
+    ret.reserve(cells.size());
+    for(const auto& [key, count] : cells) {
+        ret.push_back({static_cast<size_t>(key >> 16U),
+                       static_cast<size_t>((key >> 8U) & 0xFFU),
+                       static_cast<size_t>(key & 0xFFU) * args.bin_width,
+                       count});
+    }
+    return ret;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_joint") {
+    std::ofstream out;
+    out.open("test-joint.fa");
+    REQUIRE(out);
+    out << ">1\nAA--A-A--AC---------A-\n>2\nAA--A\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-joint.fa"};
+    std::vector<sasi::gap_cell_t> expected{{1, 0, 100, 1}, {1, 2, 23, 1},
+                                           {2, 1, 33, 1},  {2, 2, 9, 1},
+                                           {2, 2, 50, 1},  {9, 2, 52, 1}};
+    auto cells = joint(args);
+    CHECK(cells == expected);
+
+    // marginals agree with gap::position and gap::frequency
+    std::vector<size_t> by_position(101, 0);
+    size_t total{0};
+    for(const auto& cell : cells) {
+        by_position[cell.position] += cell.count;
+        total += cell.count;
+    }
+    CHECK(by_position == position(args));
+    CHECK(total == 6);
+
+    args.bin_width = 25;
+    expected = {{1, 0, 100, 1}, {1, 2, 0, 1},  {2, 1, 25, 1},
+                {2, 2, 0, 1},   {2, 2, 50, 1}, {9, 2, 50, 1}};
+    CHECK(joint(args) == expected);
+
+    args.bin_width = 0;
+    CHECK_THROWS_AS(joint(args), std::invalid_argument);
+    REQUIRE(std::filesystem::remove("test-joint.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Call fn for every gap of every sequence, in input order.
+ *
+ * @details Files are read one at a time and events are not stored, so
+ * memory is bounded by the largest input file. A gap is frameshifting if
+ * its length is not a multiple of 3. Records are numbered by their index
+ * in the file, also when `--dedup` or sampling drops some of them.
+ */
+void events(const sasi::args_t& args,
+            const std::function<void(const sasi::gap_event_t&)>& fn) {
+    for(size_t f = 0; f < args.input.size(); ++f) {
+        sasi::data_t data = sasi::fasta::read_fasta(args.input[f], args);
+        sasi::profile::scope prof{"gap::events", args.input[f]};
+        prof.add(data.bases(), data.seqs.size());
+        sasi::gap_event_t event;
+        event.file = f;
+        for(size_t r = 0; r < data.seqs.size(); ++r) {
+            event.record = data.id(r);
+            for_each_gap(data.seqs[r], [&](size_t start, size_t length) {
+                event.start = start;
+                event.length = length;
+                event.phase = start % 3;
+                event.frameshift = length % 3 != 0;
+                fn(event);
+            });
+        }
+    }
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_events") {
+    std::ofstream out;
+    out.open("test-events-1.fa");
+    REQUIRE(out);
+    out << ">1\nAA--A---A\n>2\nACGT\n>3\n-A----\n";
+    out.close();
+    out.open("test-events-2.fa");
+    REQUIRE(out);
+    out << ">1\nA-\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-events-1.fa", "test-events-2.fa"};
+    std::vector<sasi::gap_event_t> result;
+    events(args, [&result](const sasi::gap_event_t& e) {
+        result.push_back(e);
+    });
+    std::vector<sasi::gap_event_t> expected{{0, 0, 2, 2, 2, true},
+                                            {0, 0, 5, 3, 2, false},
+                                            {0, 2, 0, 1, 0, true},
+                                            {0, 2, 2, 4, 2, true},
+                                            {1, 0, 1, 1, 1, true}};
+    CHECK(result == expected);
+
+    // frameshifting events agree with gap::frameshift
+    auto frameshifts = static_cast<size_t>(
+        std::count_if(result.begin(), result.end(),
+                      [](const auto& e) { return e.frameshift; }));
+    CHECK(frameshift(frequency(args)) ==
+          std::pair<size_t, size_t>{frameshifts, result.size()});
+
+    // records dropped by --dedup or sampling keep the index of the others
+    out.open("test-events-3.fa");
+    REQUIRE(out);
+    out << ">r0\nAAAAAA\n>r1\nAAAAAA\n>r2\nAAA-AA\n>r3\n-AAAAA\n";
+    out.close();
+    args.input = {"test-events-3.fa"};
+    args.dedup = true;
+    result.clear();
+    events(args, [&result](const sasi::gap_event_t& e) {
+        result.push_back(e);
+    });
+    expected = {{0, 2, 3, 1, 0, true}, {0, 3, 0, 1, 0, true}};
+    CHECK(result == expected);
+    args.dedup = false;
+    args.sample_records = 1;
+    for(std::uint64_t seed = 1; seed <= 8; ++seed) {
+        args.seed = seed;
+        result.clear();
+        events(args, [&result](const sasi::gap_event_t& e) {
+            result.push_back(e);
+        });
+        // only r2 and r3 have gaps
+        for(const auto& e : result) {
+            CHECK(e.record >= 2);
+            CHECK(e.start == (e.record == 2 ? 3 : 0));
+        }
+    }
+    REQUIRE(std::filesystem::remove("test-events-3.fa"));
+    REQUIRE(std::filesystem::remove("test-events-1.fa"));
+    REQUIRE(std::filesystem::remove("test-events-2.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Distinct gap runs of each alignment and their sequence support.
+ *
+ * @details Identical (start, length) runs in different sequences of one file
+ * are taken as one indel event. Workers count runs in their own hash map, so
+ * memory grows with the number of distinct events, not with sequences.
+ *
+ * @return std::vector<sasi::indel_t> sorted by file, start and length.
+ */
+std::vector<sasi::indel_t> indels(const sasi::args_t& args) {
+    using map_t = std::unordered_map<indel_key_t, size_t, indel_hash_t>;
+    auto accs = sasi::sched::for_each_batch<map_t>(
+        args, [&args](map_t& support, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"gap::indels", args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                batch.gaps().for_each_run(i, [&](size_t start, size_t length) {
+                    support[{batch.file, start, length}]++;
+                });
+            }
+        });
+
+    // merge worker maps
+    map_t support = std::move(accs[0]);
+    for(size_t w = 1; w < accs.size(); ++w) {
+        for(const auto& [key, count] : accs[w]) {
+            support[key] += count;
+        }
+    }
+
+    std::vector<sasi::indel_t> ret;
+    ret.reserve(support.size());
+    for(const auto& [key, count] : support) {
+        ret.push_back({key.file, key.start, key.length, count});
+    }
+    std::sort(ret.begin(), ret.end(), [](const auto& a, const auto& b) {
+        return std::tie(a.file, a.start, a.length) <
+               std::tie(b.file, b.start, b.length);
+    });
+    return ret;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_indels") {
+    std::ofstream out;
+    out.open("test-indels-1.fa");
+    REQUIRE(out);
+    out << ">1\nAA--A---A\n>2\nAA--AC--A\n>3\nAA--A---A\n";
+    out.close();
+    out.open("test-indels-2.fa");
+    REQUIRE(out);
+    out << ">1\nAA--A\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-indels-1.fa", "test-indels-2.fa"};
+    args.threads = 2;
+    std::vector<sasi::indel_t> expected{
+        {0, 2, 2, 3}, {0, 5, 3, 2}, {0, 6, 2, 1}, {1, 2, 2, 1}};
+    CHECK(indels(args) == expected);
+
+    std::vector<std::pair<size_t, size_t>> freqs{{2, 5}, {3, 2}};
+    CHECK(frequency(args) == freqs);
+    args.unique_indels = true;
+    freqs = {{2, 3}, {3, 1}};
+    CHECK(frequency(args) == freqs);
+    REQUIRE(std::filesystem::remove("test-indels-1.fa"));
+    REQUIRE(std::filesystem::remove("test-indels-2.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Call fn for every input file with its all-gap columns removed.
+ */
+void degap_columns(const sasi::args_t& args,
+                   const std::function<void(const sasi::data_t&)>& fn) {
+    for(const auto& file : args.input) {
+        sasi::data_t data = sasi::fasta::read_fasta(file, args);
+        // --drop-gap-columns already removed them while reading
+        if(!args.drop_gap_columns) {
+            drop_gap_columns(data, sasi::utils::thread_count(args.threads));
+        }
+        fn(data);
+    }
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_degap_columns") {
+    std::ofstream out;
+    out.open("test-degap.fa");
+    REQUIRE(out);
+    out << ">1\nA--C-G\n>2\nA--CT-\n>3\n---C--\n";
+    out.close();
+    sasi::args_t args;
+    args.input = {"test-degap.fa"};
+
+    std::vector<std::string> seqs;
+    degap_columns(args, [&seqs](const sasi::data_t& data) {
+        seqs = data.seqs;
+    });
+    CHECK(seqs == std::vector<std::string>{"AC-G", "ACT-", "-C--"});
+
+    // gap statistics after dropping the all-gap columns
+    std::vector<std::pair<size_t, size_t>> expected{{1, 2}, {2, 3}, {3, 1}};
+    CHECK(frequency(args) == expected);
+    args.drop_gap_columns = true;
+    expected = {{1, 3}, {2, 1}};
+    CHECK(frequency(args) == expected);
+    REQUIRE(std::filesystem::remove("test-degap.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Estimate of a gap table from sampled records.
+ *
+ * @details Every count of the exact table is a cell of `sample::cells`,
+ * estimated per input file: gap lengths (FREQ), frameshifting and all gaps
+ * (FRMST), phases of gaps multiple of k per file (PHASE) or for every k of
+ * the range (PHASE_RANGE), start positions (POSITION), joint cells (JOINT)
+ * and the support of every indel per file (INDELS). Cells no sampled
+ * record has are left out, unless `--zeros` asks for every gap length. If
+ * no sampled record has a gap, a zero row still reports the sampled and
+ * total records, where the exact table writes 0,0.
+ *
+ * @throws std::invalid_argument for binned or unique-indel frequencies,
+ * which are not sums over records.
+ */
+sasi::sample::table_t estimate(const sasi::args_t& args, verb statistic) {
+    using batch_t = sasi::sched::batch_t;
+    using sasi::sample::total;
+    sasi::sample::table_t table;
+    switch(statistic) {
+        case verb::FREQ: {
+            if(args.bins != "exact" || args.unique_indels) {
+                throw std::invalid_argument(
+                    "Sampled gap frequencies are estimated per length, "
+                    "without --bins or --unique-indels.");
+            }
+            auto gaps = sasi::sample::cells<size_t>(
+                args, "gap::frequency",
+                [](const batch_t& batch, size_t i, auto&& add) {
+                    batch.gaps().for_each_run(
+                        i, [&add](size_t, size_t length) { add(length, 1); });
+                });
+            table.labels = "Gap_length";
+            size_t max = gaps.cells.empty() ? 0 : gaps.cells.rbegin()->first;
+            for(size_t length = 1; args.zeros && length <= max; ++length) {
+                table.rows.emplace_back(std::to_string(length),
+                                        gaps.total(length));
+            }
+            for(const auto& [length, sums] : gaps.cells) {
+                if(!args.zeros) {
+                    table.rows.emplace_back(std::to_string(length),
+                                            total(gaps.files, sums));
+                }
+            }
+            // no gaps sampled, one gap of length zero as the exact table
+            if(gaps.cells.empty()) {
+                table.rows.emplace_back("0", total(gaps.files));
+            }
+            break;
+        }
+        case verb::FRMST: {
+            // 0: frameshifting gaps, 1: all gaps
+            auto gaps = sasi::sample::cells<size_t>(
+                args, "gap::frameshift",
+                [](const batch_t& batch, size_t i, auto&& add) {
+                    batch.gaps().for_each_run(
+                        i, [&add](size_t, size_t length) {
+                            add(0, length % 3 != 0 ? 1 : 0);
+                            add(1, 1);
+                        });
+                });
+            table.labels = "statistic";
+            table.rows.emplace_back("frameshifting-gaps", gaps.total(0));
+            table.rows.emplace_back("total-gaps", gaps.total(1));
+            break;
+        }
+        case verb::PHASE: {
+            size_t k = args.k;
+            auto gaps = sasi::sample::cells<size_t>(
+                args, "gap::phase",
+                [k](const batch_t& batch, size_t i, auto&& add) {
+                    batch.gaps().for_each_run(
+                        i, [&add, k](size_t start, size_t length) {
+                            if(length % k == 0) {
+                                add(start % 3, 1);
+                            }
+                        });
+                });
+            // one row per phase of every file read, as the exact table
+            table.labels = "filename,phase";
+            for(size_t f = 0; f < args.input.size(); ++f) {
+                if(gaps.files[f].records == 0) {
+                    continue;
+                }
+                for(size_t p = 0; p < 3; ++p) {
+                    table.rows.emplace_back(
+                        args.input[f] + "," + std::to_string(p),
+                        total({gaps.stratum(p, f)}));
+                }
+            }
+            break;
+        }
+        case verb::PHASE_RANGE: {
+            check_k_range(args);
+            size_t min = args.k_range[0];
+            size_t max = args.k_range[1];
+            using key_t = std::pair<size_t, size_t>;
+            auto gaps = sasi::sample::cells<key_t>(
+                args, "gap::phase_range",
+                [min, max](const batch_t& batch, size_t i, auto&& add) {
+                    auto count = [&add, min, max](size_t start, size_t length) {
+                        for(size_t k = min; k <= std::min(max, length); ++k) {
+                            if(length % k == 0) {
+                                add(key_t{k, start % 3}, 1);
+                            }
+                        }
+                    };
+                    batch.gaps().for_each_run(i, count);
+                });
+            table.labels = "k,phase";
+            for(size_t k = min; k <= max; ++k) {
+                for(size_t p = 0; p < 3; ++p) {
+                    table.rows.emplace_back(
+                        std::to_string(k) + "," + std::to_string(p),
+                        gaps.total({k, p}));
+                }
+            }
+            break;
+        }
+        case verb::POSITION: {
+            auto gaps = sasi::sample::cells<size_t>(
+                args, "gap::position",
+                [](const batch_t& batch, size_t i, auto&& add) {
+                    std::string_view seq = batch.seq(i);
+                    batch.gaps().for_each_run(
+                        i, [&add, &seq](size_t start, size_t) {
+                            add(percent(start, seq.length()), 1);
+                        });
+                });
+            table.labels = "position";
+            for(const auto& [position, sums] : gaps.cells) {
+                table.rows.emplace_back(std::to_string(position),
+                                        total(gaps.files, sums));
+            }
+            if(gaps.cells.empty()) {
+                table.rows.emplace_back("0", total(gaps.files));
+            }
+            break;
+        }
+        case verb::JOINT: {
+            if(args.bin_width == 0 || args.bin_width > 101) {
+                throw std::invalid_argument(
+                    "Bin width must be between 1 and 101.");
+            }
+            size_t width = args.bin_width;
+            using key_t = std::tuple<size_t, size_t, size_t>;
+            auto gaps = sasi::sample::cells<key_t>(
+                args, "gap::joint",
+                [width](const batch_t& batch, size_t i, auto&& add) {
+                    std::string_view seq = batch.seq(i);
+                    batch.gaps().for_each_run(
+                        i, [&](size_t start, size_t length) {
+                            size_t bin = percent(start, seq.length()) / width;
+                            add(key_t{length, start % 3, bin * width}, 1);
+                        });
+                });
+            table.labels = "length,phase,position";
+            for(const auto& [key, sums] : gaps.cells) {
+                const auto& [length, phase, position] = key;
+                table.rows.emplace_back(std::to_string(length) + "," +
+                                            std::to_string(phase) + "," +
+                                            std::to_string(position),
+                                        total(gaps.files, sums));
+            }
+            if(gaps.cells.empty()) {
+                table.rows.emplace_back("0,0,0", total(gaps.files));
+            }
+            break;
+        }
+        case verb::INDELS: {
+            // support of each indel is estimated within its own file
+            using key_t = std::tuple<size_t, size_t, size_t>;
+            auto gaps = sasi::sample::cells<key_t>(
+                args, "gap::indels",
+                [](const batch_t& batch, size_t i, auto&& add) {
+                    size_t file = batch.file;
+                    batch.gaps().for_each_run(
+                        i, [&add, file](size_t start, size_t length) {
+                            add(key_t{file, start, length}, 1);
+                        });
+                });
+            table.labels = "filename,start,length";
+            for(const auto& [key, sums] : gaps.cells) {
+                const auto& [file, start, length] = key;
+                table.rows.emplace_back(
+                    args.input[file] + "," + std::to_string(start) + "," +
+                        std::to_string(length),
+                    total({gaps.stratum(key, file)}));
+            }
+            // no gaps sampled, keep the sampled records of every file read
+            for(size_t f = 0; gaps.cells.empty() && f < args.input.size();
+                ++f) {
+                if(gaps.files[f].records > 0) {
+                    table.rows.emplace_back(args.input[f] + ",0,0",
+                                            total({gaps.files[f]}));
+                }
+            }
+            break;
+        }
+    }
+    return table;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_estimate") {
+    std::ofstream out;
+    out.open("test-gap-estimate-1.fa");
+    REQUIRE(out);
+    out << ">1\nAA--A---A\n>2\nAA--AC--A\n>3\nAA--A---A\n";
+    out.close();
+    out.open("test-gap-estimate-2.fa");
+    REQUIRE(out);
+    out << ">1\nA-----A\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-gap-estimate-1.fa", "test-gap-estimate-2.fa"};
+    args.threads = 2;
+    auto values = [&args](verb statistic) {
+        std::vector<std::pair<std::string, double>> ret;
+        for(const auto& [label, estimate] : estimate(args, statistic).rows) {
+            // every record is read: exact counts, no uncertainty
+            CHECK(estimate.low == estimate.value);
+            CHECK(estimate.high == estimate.value);
+            ret.emplace_back(label, estimate.value);
+        }
+        return ret;
+    };
+    using rows_t = std::vector<std::pair<std::string, double>>;
+
+    SUBCASE("frequency") {
+        CHECK(values(verb::FREQ) == rows_t{{"2", 4}, {"3", 2}, {"5", 1}});
+        args.zeros = true;
+        CHECK(values(verb::FREQ) ==
+              rows_t{{"1", 0}, {"2", 4}, {"3", 2}, {"4", 0}, {"5", 1}});
+        args.bins = "log";
+        CHECK_THROWS_AS(estimate(args, verb::FREQ), std::invalid_argument);
+        args.bins = "exact";
+        args.unique_indels = true;
+        CHECK_THROWS_AS(estimate(args, verb::FREQ), std::invalid_argument);
+    }
+    SUBCASE("frameshift") {
+        auto [frameshifts, gaps] = frameshift(frequency(args));
+        CHECK(values(verb::FRMST) ==
+              rows_t{{"frameshifting-gaps", frameshifts},
+                     {"total-gaps", gaps}});
+    }
+    SUBCASE("phase") {
+        args.k = 1;
+        auto phases = phase(args);
+        rows_t expected;
+        for(size_t f = 0; f < phases.size(); ++f) {
+            for(size_t p = 0; p < 3; ++p) {
+                expected.emplace_back(args.input[f] + "," + std::to_string(p),
+                                      phases[f][p]);
+            }
+        }
+        CHECK(values(verb::PHASE) == expected);
+    }
+    SUBCASE("phase range") {
+        args.k_range = {1, 3};
+        auto phases = phase_range(args);
+        rows_t expected;
+        for(size_t k = 1; k <= 3; ++k) {
+            for(size_t p = 0; p < 3; ++p) {
+                expected.emplace_back(
+                    std::to_string(k) + "," + std::to_string(p),
+                    phases[k - 1][p]);
+            }
+        }
+        CHECK(values(verb::PHASE_RANGE) == expected);
+    }
+    SUBCASE("position and joint") {
+        auto positions = position(args);
+        rows_t expected;
+        for(size_t i = 0; i < positions.size(); ++i) {
+            if(positions[i] > 0) {
+                expected.emplace_back(std::to_string(i), positions[i]);
+            }
+        }
+        CHECK(values(verb::POSITION) == expected);
+        expected.clear();
+        for(const auto& cell : joint(args)) {
+            expected.emplace_back(std::to_string(cell.length) + "," +
+                                      std::to_string(cell.phase) + "," +
+                                      std::to_string(cell.position),
+                                  cell.count);
+        }
+        CHECK(values(verb::JOINT) == expected);
+    }
+    SUBCASE("indels") {
+        rows_t expected;
+        for(const auto& indel : indels(args)) {
+            expected.emplace_back(args.input[indel.file] + "," +
+                                      std::to_string(indel.start) + "," +
+                                      std::to_string(indel.length),
+                                  indel.support);
+        }
+        CHECK(values(verb::INDELS) == expected);
+    }
+    SUBCASE("sampled") {
+        args.sample_records = 1;
+        auto table = estimate(args, verb::FRMST);
+        REQUIRE(table.rows.size() == 2);
+        // one record of three in the first file: no variance, unknown bounds
+        CHECK(table.rows[1].second.sampled == 2);
+        CHECK(table.rows[1].second.records == 4);
+        CHECK(std::isnan(table.rows[1].second.low));
+    }
+    SUBCASE("no gaps") {
+        out.open("test-gap-estimate-3.fa");
+        REQUIRE(out);
+        out << ">1\nACGT\n>2\nAC\n";
+        out.close();
+        args.input = {"test-gap-estimate-3.fa"};
+        // a zero row keeps the sampled and total records
+        CHECK(values(verb::FREQ) == rows_t{{"0", 0}});
+        CHECK(values(verb::POSITION) == rows_t{{"0", 0}});
+        CHECK(values(verb::JOINT) == rows_t{{"0,0,0", 0}});
+        CHECK(values(verb::INDELS) ==
+              rows_t{{"test-gap-estimate-3.fa,0,0", 0}});
+        auto table = estimate(args, verb::FREQ);
+        CHECK(table.rows[0].second.sampled == 2);
+        CHECK(table.rows[0].second.records == 2);
+        REQUIRE(std::filesystem::remove("test-gap-estimate-3.fa"));
+    }
+    REQUIRE(std::filesystem::remove("test-gap-estimate-1.fa"));
+    REQUIRE(std::filesystem::remove("test-gap-estimate-2.fa"));
+}
+// GCOVR_EXCL_STOP
+
 }  // namespace sasi::gap
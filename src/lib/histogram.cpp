@@ -0,0 +1,309 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <sasi/histogram.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace sasi::hist {
+
+namespace {
+// index of the bucket holding value
+size_t bucket_index(size_t value, binning bins, size_t width) {
+    switch(bins) {
+    case binning::linear:
+        return value / width;
+    case binning::log: {
+        // 0 -> 0, 1 -> 1, [2, 3] -> 2, [4, 7] -> 3, ...
+        size_t index{0};
+        for(; value > 0; value >>= 1U) {
+            index++;
+        }
+        return index;
+    }
+    default:
+        return value;
+    }
+}
+
+// closed value range of bucket index
+std::pair<size_t, size_t> bucket_range(size_t index, binning bins,
+                                       size_t width) {
+    constexpr size_t max = std::numeric_limits<size_t>::max();
+    switch(bins) {
+    case binning::linear: {
+        size_t low = index * width;
+        return {low, low > max - (width - 1) ? max : low + (width - 1)};
+    }
+    case binning::log:
+        if(index == 0) {
+            return {0, 0};
+        }
+        if(index >= std::numeric_limits<size_t>::digits) {
+            return {size_t{1} << (index - 1), max};
+        }
+        return {size_t{1} << (index - 1), (size_t{1} << index) - 1};
+    default:
+        return {index, index};
+    }
+}
+}  // namespace
+
+// values below DENSE_MAX double the vector, larger ones go to the map
+void histogram_t::grow(size_t value, size_t n) {
+    if(value >= DENSE_MAX) {
+        sparse_[value] += n;
+        return;
+    }
+    dense_.resize(std::min(DENSE_MAX, std::max(value + 1, 2 * dense_.size())));
+    dense_[value] += n;
+}
+
+void histogram_t::merge(const histogram_t& other) {
+    if(dense_.size() < other.dense_.size()) {
+        dense_.resize(other.dense_.size());
+    }
+    for(size_t i = 0; i < other.dense_.size(); ++i) {
+        dense_[i] += other.dense_[i];
+    }
+    for(const auto& [value, n] : other.sparse_) {
+        sparse_[value] += n;
+    }
+}
+
+size_t histogram_t::total() const {
+    size_t total{0};
+    for(size_t n : dense_) {
+        total += n;
+    }
+    for(const auto& entry : sparse_) {
+        total += entry.second;
+    }
+    return total;
+}
+
+bool histogram_t::empty() const { return total() == 0; }
+
+/**
+ * @brief Non-zero (value, count) pairs in increasing value order.
+ */
+std::vector<std::pair<size_t, size_t>> histogram_t::counts() const {
+    std::vector<std::pair<size_t, size_t>> ret;
+    for(size_t i = 0; i < dense_.size(); ++i) {
+        if(dense_[i] > 0) {
+            ret.emplace_back(i, dense_[i]);
+        }
+    }
+    // every sparse value is at least DENSE_MAX, so order is kept
+    ret.insert(ret.end(), sparse_.begin(), sparse_.end());
+    return ret;
+}
+
+/**
+ * @brief Replace automatic binning by exact or log bins.
+ */
+binning histogram_t::resolve(binning bins) const {
+    if(bins != binning::automatic) {
+        return bins;
+    }
+    return counts().size() > AUTO_MAX_ROWS ? binning::log : binning::exact;
+}
+
+/**
+ * @brief Group counts into buckets.
+ *
+ * @details Linear buckets are `width` values wide starting at 0; log
+ * buckets are [0], [1], [2, 3], [4, 7], ... Only non-empty buckets are
+ * returned unless `zeros` is set, which adds the empty buckets between the
+ * first and last non-empty one.
+ *
+ * @param bins binning scheme
+ * @param width bucket width for linear bins
+ * @param zeros include empty buckets
+ * @return std::vector<bucket_t> buckets in increasing value order.
+ */
+std::vector<bucket_t> histogram_t::buckets(binning bins, size_t width,
+                                           bool zeros) const {
+    if(width == 0) {
+        throw std::invalid_argument("Histogram bin width must be positive.");
+    }
+    bins = resolve(bins);
+    std::vector<bucket_t> ret;
+    size_t last{0};
+    for(const auto& [value, n] : counts()) {
+        size_t index = bucket_index(value, bins, width);
+        if(!ret.empty() && index == last) {
+            ret.back().count += n;
+            continue;
+        }
+        if(zeros && !ret.empty()) {
+            for(size_t i = last + 1; i < index; ++i) {
+                auto [low, high] = bucket_range(i, bins, width);
+                ret.push_back(bucket_t{low, high, 0});
+            }
+        }
+        auto [low, high] = bucket_range(index, bins, width);
+        ret.push_back(bucket_t{low, high, n});
+        last = index;
+    }
+    return ret;
+}
+
+/**
+ * @brief Binning scheme from its command line name.
+ */
+binning parse_binning(const std::string& name) {
+    if(name == "exact") {
+        return binning::exact;
+    }
+    if(name == "linear") {
+        return binning::linear;
+    }
+    if(name == "log") {
+        return binning::log;
+    }
+    if(name == "auto") {
+        return binning::automatic;
+    }
+    throw std::invalid_argument("Unknown histogram binning: " + name);
+}
+
+/**
+ * @brief Write a histogram as CSV.
+ *
+ * @details Exact bins are written as "label,count" rows, other bins as
+ * "label_min,label_max,count" rows.
+ */
+void write(const histogram_t& hist, binning bins, size_t width, bool zeros,
+           const std::string& label, std::ostream& out) {
+    bins = hist.resolve(bins);
+    bool exact = bins == binning::exact;
+    if(exact) {
+        out << label << ",count" << std::endl;
+    } else {
+        out << label << "_min," << label << "_max,count" << std::endl;
+    }
+    // long zero-filled ranges: format rows with to_chars, three 20-digit
+    // numbers and their separators take at most 63 characters
+    std::array<char, 64> row{};
+    char* const end = row.data() + row.size();
+    auto field = [end](char* p, size_t value, char sep) {
+        // keep one character for the separator
+        auto [last, ec] = std::to_chars(p, end - 1, value);
+        if(ec != std::errc{}) {
+            throw std::runtime_error("Histogram row too long.");
+        }
+        *last = sep;
+        return last + 1;
+    };
+    for(const auto& bucket : hist.buckets(bins, width, zeros)) {
+        char* p = field(row.data(), bucket.low, ',');
+        if(!exact) {
+            p = field(p, bucket.high, ',');
+        }
+        p = field(p, bucket.count, '\n');
+        out.write(row.data(), p - row.data());
+    }
+    out.flush();
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("histogram") {
+    histogram_t hist;
+    for(size_t value : {1, 1, 2, 3, 5, 9}) {
+        hist.add(value);
+    }
+    hist.add(DENSE_MAX + 10, 2);
+    using counts_t = std::vector<std::pair<size_t, size_t>>;
+
+    SUBCASE("dense and sparse counts") {
+        counts_t expected{{1, 2}, {2, 1}, {3, 1}, {5, 1}, {9, 1},
+                          {DENSE_MAX + 10, 2}};
+        CHECK(hist.counts() == expected);
+        CHECK(hist.total() == 8);
+        CHECK_FALSE(hist.empty());
+        CHECK(histogram_t{}.empty());
+    }
+    SUBCASE("merge") {
+        histogram_t other;
+        other.add(2, 3);
+        other.add(DENSE_MAX + 10);
+        other.add(DENSE_MAX * 4);
+        hist.merge(other);
+        counts_t expected{{1, 2},
+                          {2, 4},
+                          {3, 1},
+                          {5, 1},
+                          {9, 1},
+                          {DENSE_MAX + 10, 3},
+                          {DENSE_MAX * 4, 1}};
+        CHECK(hist.counts() == expected);
+    }
+    SUBCASE("linear bins") {
+        std::vector<bucket_t> expected{{0, 3, 4},
+                                       {4, 7, 1},
+                                       {8, 11, 1},
+                                       {DENSE_MAX + 8, DENSE_MAX + 11, 2}};
+        CHECK(hist.buckets(binning::linear, 4) == expected);
+        CHECK(hist.buckets(binning::linear, 4, true).size() ==
+              DENSE_MAX / 4 + 3);
+        CHECK_THROWS_AS(static_cast<void>(hist.buckets(binning::linear, 0)),
+                        std::invalid_argument);
+    }
+    SUBCASE("log bins") {
+        std::vector<bucket_t> expected{{1, 1, 2},
+                                       {2, 3, 2},
+                                       {4, 7, 1},
+                                       {8, 15, 1},
+                                       {DENSE_MAX, DENSE_MAX * 2 - 1, 2}};
+        CHECK(hist.buckets(binning::log) == expected);
+        auto with_zeros = hist.buckets(binning::log, 1, true);
+        CHECK(with_zeros.size() == 17);
+        CHECK(with_zeros[4] == bucket_t{16, 31, 0});
+    }
+    SUBCASE("automatic bins") {
+        CHECK(hist.resolve(binning::automatic) == binning::exact);
+        histogram_t wide;
+        for(size_t i = 1; i <= AUTO_MAX_ROWS + 1; ++i) {
+            wide.add(i * 7);
+        }
+        CHECK(wide.resolve(binning::automatic) == binning::log);
+        CHECK(wide.resolve(binning::linear) == binning::linear);
+    }
+    SUBCASE("parse") {
+        CHECK(parse_binning("exact") == binning::exact);
+        CHECK(parse_binning("linear") == binning::linear);
+        CHECK(parse_binning("log") == binning::log);
+        CHECK(parse_binning("auto") == binning::automatic);
+        CHECK_THROWS_AS(parse_binning("cubic"), std::invalid_argument);
+    }
+    SUBCASE("write") {
+        std::ostringstream exact;
+        write(hist, binning::exact, 1, false, "Gap_length", exact);
+        CHECK(exact.str() == "Gap_length,count\n1,2\n2,1\n3,1\n5,1\n9,1\n" +
+                                 std::to_string(DENSE_MAX + 10) + ",2\n");
+        std::ostringstream log;
+        histogram_t small;
+        small.add(1);
+        small.add(5, 3);
+        write(small, binning::log, 1, true, "Gap_length", log);
+        CHECK(log.str() ==
+              "Gap_length_min,Gap_length_max,count\n1,1,1\n2,3,0\n4,7,3\n");
+        std::ostringstream widest;
+        histogram_t big;
+        big.add(SIZE_MAX, SIZE_MAX);
+        write(big, binning::exact, 1, false, "Gap_length", widest);
+        CHECK(widest.str() == "Gap_length,count\n" + std::to_string(SIZE_MAX) +
+                                  "," + std::to_string(SIZE_MAX) + "\n");
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::hist
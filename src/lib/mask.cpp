@@ -0,0 +1,423 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <sasi/gap.hpp>
+#include <sasi/mask.hpp>
+#include <sasi/profile.hpp>
+#include <sasi/scheduler.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace sasi::gap {
+
+namespace {
+size_t popcount(std::uint64_t x) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcountll(x));
+#else
+    return std::bitset<64>(x).count();
+#endif
+}
+
+// first column >= from of n_words words whose value is value, or limit
+size_t next_column(const std::uint64_t* words, size_t n_words, size_t from,
+                   size_t limit, bool value) {
+    while(from < limit) {
+        std::uint64_t word = from / 64 < n_words ? words[from / 64] : 0;
+        size_t base = from - from % 64;
+        size_t bit = next_bit(word, from % 64, 64, value);
+        if(bit < 64) {
+            return std::min(limit, base + bit);
+        }
+        from = base + 64;
+    }
+    return limit;
+}
+}  // namespace
+
+/**
+ * @brief Gap bits of up to 64 characters, bit i set if chars[i] is a gap.
+ *
+ * @details Full blocks compare 16 characters at a time and collect the
+ * results with movemask when SSE2 is available.
+ */
+std::uint64_t gap_bits(const char* chars, size_t n) {
+    std::uint64_t bits{0};
+    size_t i{0};
+#if defined(__SSE2__)
+    if(n == 64) {
+        const __m128i gap = _mm_set1_epi8(GAP);
+        for(; i < 64; i += 16) {
+            __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(chars + i));  // NOLINT
+            auto m = static_cast<std::uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(v, gap)));
+            bits |= std::uint64_t{m} << i;
+        }
+        return bits;
+    }
+#endif
+    for(; i < n; ++i) {
+        bits |= static_cast<std::uint64_t>(chars[i] == GAP) << i;
+    }
+    return bits;
+}
+
+/**
+ * @brief Mask of one sequence, record 0.
+ */
+mask_t::mask_t(std::string_view seq) { add(seq); }
+
+/**
+ * @brief Mask of records [first, last) of data, 64 columns per step.
+ */
+mask_t::mask_t(const sasi::data_t& data, size_t first, size_t last)
+    : first_{first} {
+    size_t words{0};
+    for(size_t r = first; r < last; ++r) {
+        words += (data.seqs[r].size() + 63) / 64;
+    }
+    words_.reserve(words);
+    lengths_.reserve(last - first);
+    offsets_.reserve(last - first);
+    for(size_t r = first; r < last; ++r) {
+        add(data.seqs[r]);
+    }
+}
+
+void mask_t::add(std::string_view seq) {
+    lengths_.push_back(seq.size());
+    offsets_.push_back(words_.size());
+    for(size_t i = 0; i < seq.size(); i += 64) {
+        words_.push_back(
+            gap_bits(seq.data() + i, std::min<size_t>(64, seq.size() - i)));
+    }
+}
+
+/**
+ * @brief Number of gaps of record r.
+ */
+size_t mask_t::count(size_t r) const {
+    size_t first = offsets_[r - first_];
+    size_t last = first + (length(r) + 63) / 64;
+    size_t gaps{0};
+    for(size_t w = first; w < last; ++w) {
+        gaps += popcount(words_[w]);
+    }
+    return gaps;
+}
+
+// first column >= from of record r whose bit equals value, or its length
+size_t mask_t::next(size_t r, size_t from, bool value) const {
+    size_t length = this->length(r);
+    return next_column(words_.data() + offsets_[r - first_],
+                       (length + 63) / 64, from, length, value);
+}
+
+/**
+ * @brief AND the gap words of every record into all_gap.
+ *
+ * @details Columns past the end of a record count as gaps, so all_gap
+ * keeps its size, one bit per column.
+ *
+ * @return bool whether any column of all_gap is still all-gap.
+ */
+bool mask_t::and_gaps(std::vector<std::uint64_t>& all_gap) const {
+    for(size_t k = 0; k < size(); ++k) {
+        size_t n_words = (lengths_[k] + 63) / 64;
+        for(size_t w = 0; w < n_words && w < all_gap.size(); ++w) {
+            std::uint64_t word = words_[offsets_[k] + w];
+            size_t used = lengths_[k] - w * 64;
+            if(used < 64) {
+                word |= ~std::uint64_t{0} << used;
+            }
+            all_gap[w] &= word;
+        }
+    }
+    return std::any_of(all_gap.begin(), all_gap.end(),
+                       [](std::uint64_t w) { return w != 0; });
+}
+
+/**
+ * @brief Copy record r, whose characters are seq, into out without gaps.
+ *
+ * @details Runs of non-gap columns are found with bit scans and appended
+ * with one copy each, as in `compact`.
+ */
+void mask_t::degap(size_t r, std::string_view seq, std::string& out) const {
+    out.clear();
+    out.reserve(ungapped(r));
+    size_t n = length(r);
+    size_t col = next(r, 0, false);
+    while(col < n) {
+        size_t stop = next(r, col, true);
+        out.append(seq.data() + col, stop - col);
+        col = next(r, stop, false);
+    }
+}
+
+/**
+ * @brief Columns that are gaps in every record of data.
+ *
+ * @details AND of the 64-column gap words of all records, reduced on
+ * `threads` workers over record ranges. Each worker builds the `mask_t` of
+ * a few records at a time and ANDs it into its partial result, stopping
+ * once none of its columns can be all-gap; the partial results are then
+ * ANDed. Records shorter than the longest one count as gaps past their
+ * end.
+ *
+ * @return std::vector<std::uint64_t> bit i set if column i is all-gap.
+ */
+std::vector<std::uint64_t> gap_columns(const sasi::data_t& data,
+                                       size_t threads) {
+    constexpr size_t MASK_RECORDS{64};
+    size_t columns{0};
+    for(const auto& seq : data.seqs) {
+        columns = std::max(columns, seq.size());
+    }
+    size_t n_words = (columns + 63) / 64;
+    size_t n = data.seqs.size();
+    threads = std::max<size_t>(1, std::min(threads, n));
+    std::vector<std::vector<std::uint64_t>> parts(
+        threads, std::vector<std::uint64_t>(n_words, ~std::uint64_t{0}));
+    sasi::sched::pool_t pool(threads);
+    for(size_t t = 0; t < threads; ++t) {
+        pool.push(t, [&, t](size_t /*worker*/) {
+            size_t last = n * (t + 1) / threads;
+            for(size_t r = n * t / threads; r < last; r += MASK_RECORDS) {
+                mask_t mask(data, r, std::min(last, r + MASK_RECORDS));
+                if(!mask.and_gaps(parts[t])) {
+                    return;
+                }
+            }
+        });
+    }
+    pool.run();
+
+    std::vector<std::uint64_t> ret(n_words, n > 0 ? ~std::uint64_t{0} : 0);
+    for(const auto& part : parts) {
+        for(size_t w = 0; w < n_words; ++w) {
+            ret[w] &= part[w];
+        }
+    }
+    if(columns % 64 != 0) {
+        ret.back() &= (std::uint64_t{1} << (columns % 64)) - 1;
+    }
+    return ret;
+}
+
+/**
+ * @brief Remove the columns of seq whose bit is set in drop, in place.
+ *
+ * @details Runs of kept columns are found with bit scans and moved with
+ * one memmove each, so unchanged stretches are copied at memory speed.
+ */
+void compact(std::string& seq, const std::vector<std::uint64_t>& drop) {
+    size_t n = seq.size();
+    size_t out{0};
+    size_t col = next_column(drop.data(), drop.size(), 0, n, true);
+    if(col == n) {
+        return;
+    }
+    out = col;
+    while(col < n) {
+        size_t keep = next_column(drop.data(), drop.size(), col, n, false);
+        size_t stop = next_column(drop.data(), drop.size(), keep, n, true);
+        std::memmove(seq.data() + out, seq.data() + keep, stop - keep);
+        out += stop - keep;
+        col = stop;
+    }
+    seq.resize(out);
+}
+
+/**
+ * @brief Remove the columns that are gaps in every record of data.
+ *
+ * @return size_t number of columns removed.
+ */
+size_t drop_gap_columns(sasi::data_t& data, size_t threads) {
+    constexpr size_t COMPACT_BATCH{256};
+    const std::string file = data.path.string();
+    sasi::profile::scope prof{"gap::drop_gap_columns", file};
+    prof.add(data.bases(), data.seqs.size());
+    std::vector<std::uint64_t> drop = gap_columns(data, threads);
+    size_t dropped{0};
+    for(std::uint64_t word : drop) {
+        dropped += popcount(word);
+    }
+    if(dropped == 0) {
+        return 0;
+    }
+    size_t n = data.seqs.size();
+    sasi::sched::pool_t pool(threads);
+    for(size_t first = 0; first < n; first += COMPACT_BATCH) {
+        pool.push(first / COMPACT_BATCH, [&, first](size_t /*worker*/) {
+            for(size_t r = first; r < std::min(n, first + COMPACT_BATCH);
+                ++r) {
+                compact(data.seqs[r], drop);
+                if(!data.quals.empty()) {
+                    compact(data.quals[r], drop);
+                }
+            }
+        });
+    }
+    pool.run();
+    return dropped;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_bits") {
+    std::string seq(150, 'A');
+    for(size_t i : {0, 1, 63, 64, 65, 100, 149}) {
+        seq[i] = GAP;
+    }
+    SUBCASE("mask") {
+        sasi::data_t data;
+        data.names = {"1", "2", "3", "4"};
+        data.seqs = {seq, "AA--A---A", "", "-C-"};
+        mask_t mask(data);
+        REQUIRE(mask.size() == 4);
+        CHECK(mask.count(0) == 7);
+        CHECK(mask.ungapped(0) == 143);
+        CHECK(mask.count(1) == 5);
+        CHECK(mask.count(2) == 0);
+        CHECK(mask.gap(0, 64));
+        CHECK_FALSE(mask.gap(0, 66));
+
+        std::string out;
+        mask.degap(1, data.seqs[1], out);
+        CHECK(out == "AAAA");
+        mask.degap(0, seq, out);
+        CHECK(out == std::string(143, 'A'));
+        mask.degap(2, data.seqs[2], out);
+        CHECK(out.empty());
+
+        // runs agree with for_each_gap
+        for(size_t r = 0; r < data.seqs.size(); ++r) {
+            std::vector<std::pair<size_t, size_t>> runs, expected;
+            mask.for_each_run(r, [&runs](size_t start, size_t length) {
+                runs.emplace_back(start, length);
+            });
+            for_each_gap(data.seqs[r], [&expected](size_t start,
+                                                   size_t length) {
+                expected.emplace_back(start, length);
+            });
+            CHECK(runs == expected);
+        }
+
+        // records past the end of the shorter ones count as gaps
+        std::vector<std::uint64_t> all_gap(3, ~std::uint64_t{0});
+        CHECK(mask.and_gaps(all_gap));
+        CHECK(all_gap[0] == (std::uint64_t{1} << 63U));
+        CHECK(all_gap[1] == 0b11U + (std::uint64_t{1} << 36U));
+        CHECK(all_gap[2] == ~std::uint64_t{0} << 21U);
+        mask_t("ACG").and_gaps(all_gap);
+        CHECK(all_gap[0] == (std::uint64_t{1} << 63U));
+        CHECK_FALSE(mask_t(std::string(192, 'A')).and_gaps(all_gap));
+
+        // a range keeps the record indices of data
+        mask_t range(data, 1, 3);
+        REQUIRE(range.size() == 2);
+        CHECK(range.count(1) == 5);
+        CHECK(range.length(2) == 0);
+        CHECK(mask_t("A--").count(0) == 2);
+    }
+    SUBCASE("next bit") {
+        std::uint64_t word = gap_bits(seq.data() + 64, 64);
+        CHECK(word == 0b11U + (std::uint64_t{1} << 36U));
+        CHECK(next_bit(word, 0, 64, true) == 0);
+        CHECK(next_bit(word, 1, 64, false) == 2);
+        CHECK(next_bit(word, 2, 64, true) == 36);
+        CHECK(next_bit(word, 37, 64, true) == 64);
+        CHECK(next_bit(word, 2, 20, true) == 20);
+        CHECK(next_bit(word, 64, 64, true) == 64);
+    }
+    SUBCASE("runs") {
+        std::vector<std::pair<size_t, size_t>> runs;
+        auto collect = [&runs](size_t start, size_t length) {
+            runs.emplace_back(start, length);
+        };
+        for_each_gap("AA--A---A", collect);
+        std::vector<std::pair<size_t, size_t>> expected{{2, 2}, {5, 3}};
+        CHECK(runs == expected);
+        runs.clear();
+        for_each_gap(seq, collect);
+        expected = {{0, 2}, {63, 3}, {100, 1}, {149, 1}};
+        CHECK(runs == expected);
+        runs.clear();
+        for_each_gap(std::string(200, GAP), collect);
+        expected = {{0, 200}};
+        CHECK(runs == expected);
+        runs.clear();
+        for_each_gap("", collect);
+        CHECK(runs.empty());
+    }
+}
+// GCOVR_EXCL_STOP
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("gap_columns") {
+    sasi::data_t data;
+    data.names = {"1", "2", "3"};
+    std::string a(130, 'A'), b(130, '-'), c(70, '-');
+    a[0] = a[5] = a[64] = a[129] = GAP;
+    b[1] = b[66] = 'C';
+    c[3] = 'G';
+    data.seqs = {a, b, c};
+    // all-gap: 0, 5, 64 and 129
+    std::vector<std::uint64_t> expected{1U | (1U << 5U), 1U, 2U};
+
+    SUBCASE("mask") {
+        CHECK(gap_columns(data) == expected);
+        CHECK(gap_columns(data, 3) == expected);
+        CHECK(gap_columns(sasi::data_t{}).empty());
+        data.seqs[1][5] = 'T';
+        expected[0] = 1U;
+        CHECK(gap_columns(data, 2) == expected);
+    }
+    SUBCASE("compact") {
+        std::string seq{"A-CG--T"};
+        compact(seq, {0b0110010});
+        CHECK(seq == "ACGT");
+        seq = "ACGT";
+        compact(seq, {0});
+        CHECK(seq == "ACGT");
+        seq = std::string(128, 'A') + "C";
+        compact(seq, {~std::uint64_t{0}, 0, 0});
+        CHECK(seq == std::string(64, 'A') + "C");
+    }
+    SUBCASE("drop columns") {
+        CHECK(drop_gap_columns(data, 2) == 4);
+        CHECK(data.seqs[0] == std::string(126, 'A'));
+        CHECK(data.seqs[1].size() == 126);
+        CHECK(data.seqs[1][0] == 'C');
+        CHECK(data.seqs[1][63] == 'C');
+        CHECK(data.seqs[2].size() == 67);
+        CHECK(data.seqs[2][2] == 'G');
+        CHECK(drop_gap_columns(data) == 0);
+    }
+    SUBCASE("profiled") {
+        // longer than any short string buffer
+        data.path = std::string(64, 'x') + ".fasta";
+        sasi::profile::reset();
+        sasi::profile::enable(true);
+        CHECK(drop_gap_columns(data, 2) == 4);
+        sasi::profile::enable(false);
+        auto files = sasi::profile::files();
+        REQUIRE(files.size() == 1);
+        CHECK(files[0].name == data.path.string());
+        CHECK(files[0].records == 3);
+        sasi::profile::reset();
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::gap
@@ -0,0 +1,211 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sasi/memory.hpp>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define SASI_ALLOC_HOOKS 1
+#endif
+
+namespace sasi::memory {
+
+namespace {
+std::atomic<bool> g_enabled{false};
+std::atomic<std::int64_t> g_live{0};
+std::atomic<std::int64_t> g_peak{0};
+
+// plain thread_local PODs: no dynamic initialization inside operator new
+thread_local counters_t t_counters;
+
+void track_alloc(size_t size) {
+    auto bytes = static_cast<std::int64_t>(size);
+    t_counters.allocs++;
+    t_counters.bytes += size;
+    t_counters.live += bytes;
+    if(t_counters.live > t_counters.peak) {
+        t_counters.peak = t_counters.live;
+    }
+    std::int64_t live =
+        g_live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::int64_t peak = g_peak.load(std::memory_order_relaxed);
+    while(live > peak && !g_peak.compare_exchange_weak(
+                             peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void track_free(size_t size) {
+    auto bytes = static_cast<std::int64_t>(size);
+    t_counters.live -= bytes;
+    g_live.fetch_sub(bytes, std::memory_order_relaxed);
+}
+}  // namespace
+
+#if defined(SASI_ALLOC_HOOKS)
+/// @private
+void* allocate(std::size_t size) {
+    if(size == 0) {
+        size = 1;
+    }
+    void* ptr{nullptr};
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+    while((ptr = std::malloc(size)) == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    if(g_enabled.load(std::memory_order_relaxed)) {
+        track_alloc(malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
+/// @private
+void release(void* ptr) noexcept {
+    if(ptr == nullptr) {
+        return;
+    }
+    if(g_enabled.load(std::memory_order_relaxed)) {
+        track_free(malloc_usable_size(ptr));
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+    std::free(ptr);
+}
+#endif
+
+/**
+ * @brief Whether global operator new/delete are hooked on this platform.
+ *
+ * @details Freed sizes are recovered with `malloc_usable_size`, so hooks are
+ * only installed with glibc and add no per-allocation header.
+ */
+bool available() {
+#if defined(SASI_ALLOC_HOOKS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void enable(bool on) {
+    g_enabled.store(on && available(), std::memory_order_relaxed);
+}
+
+bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+counters_t thread_counters() { return t_counters; }
+
+/**
+ * @brief Start a new high-water mark for the calling thread.
+ *
+ * @return previous high-water mark, to pass to `restore_thread_peak`.
+ */
+std::int64_t reset_thread_peak() {
+    std::int64_t previous = t_counters.peak;
+    t_counters.peak = t_counters.live;
+    return previous;
+}
+
+void restore_thread_peak(std::int64_t peak) {
+    if(peak > t_counters.peak) {
+        t_counters.peak = peak;
+    }
+}
+
+size_t heap_live() {
+    std::int64_t live = g_live.load(std::memory_order_relaxed);
+    return live > 0 ? static_cast<size_t>(live) : 0;
+}
+
+size_t heap_peak() {
+    return static_cast<size_t>(g_peak.load(std::memory_order_relaxed));
+}
+
+/**
+ * @brief Maximum resident set size of the process in bytes.
+ */
+size_t max_rss() {
+    rusage usage{};
+    if(getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("memory") {
+    if(!available()) {
+        return;
+    }
+    enable(true);
+    counters_t before = thread_counters();
+    std::int64_t saved = reset_thread_peak();
+    {
+        std::vector<char> buffer(4096);
+        buffer[0] = 'A';
+        counters_t during = thread_counters();
+        CHECK(during.allocs == before.allocs + 1);
+        CHECK(during.bytes >= before.bytes + 4096);
+        CHECK(during.live >= before.live + 4096);
+    }
+    counters_t after = thread_counters();
+    enable(false);
+    CHECK(after.live == before.live);
+    CHECK(after.peak >= before.live + 4096);
+    CHECK(heap_peak() >= 4096);
+    restore_thread_peak(saved);
+    CHECK(thread_counters().peak >= saved);
+    CHECK(max_rss() > 0);
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::memory
+
+#if defined(SASI_ALLOC_HOOKS)
+// Replacement global allocation functions. Aligned overloads keep the default
+// implementation, which does not route through these.
+void* operator new(std::size_t size) { return sasi::memory::allocate(size); }
+void* operator new[](std::size_t size) { return sasi::memory::allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t& /*tag*/) noexcept {
+    try {
+        return sasi::memory::allocate(size);
+    } catch(...) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t& /*tag*/) noexcept {
+    try {
+        return sasi::memory::allocate(size);
+    } catch(...) {
+        return nullptr;
+    }
+}
+void operator delete(void* ptr) noexcept { sasi::memory::release(ptr); }
+void operator delete[](void* ptr) noexcept { sasi::memory::release(ptr); }
+void operator delete(void* ptr, std::size_t /*size*/) noexcept {
+    sasi::memory::release(ptr);
+}
+void operator delete[](void* ptr, std::size_t /*size*/) noexcept {
+    sasi::memory::release(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t& /*tag*/) noexcept {
+    sasi::memory::release(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t& /*tag*/) noexcept {
+    sasi::memory::release(ptr);
+}
+#endif
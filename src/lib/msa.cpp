@@ -0,0 +1,364 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <cctype>
+#include <sasi/fasta.hpp>
+#include <sasi/msa.hpp>
+#include <sasi/phylip.hpp>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sasi::msa {
+
+namespace {
+constexpr std::string_view BLANK{" \t\r\v\f"};
+
+bool is_blank(char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// call f(line) for every line of buffer without its trailing '\r'
+template <class F>
+void for_each_line(std::string_view buffer, F&& f) {
+    size_t pos{0};
+    while(pos < buffer.size()) {
+        size_t eol = buffer.find('\n', pos);
+        if(eol == std::string_view::npos) {
+            eol = buffer.size();
+        }
+        std::string_view line = buffer.substr(pos, eol - pos);
+        pos = eol + 1;
+        if(!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        f(line);
+    }
+}
+
+// first word of line and the rest after it
+std::pair<std::string_view, std::string_view> split_word(
+    std::string_view line) {
+    size_t end = std::min(line.find_first_of(BLANK), line.size());
+    return {line.substr(0, end), line.substr(end)};
+}
+
+/**
+ * @brief Records of an interleaved "name sequence" format, kept in order of
+ * first appearance.
+ *
+ * @details Names and sequences are views of the input buffer, so names are
+ * looked up without copies and their offsets give the size of each block.
+ * Once the first block of an alignment is complete (a name repeats), every
+ * sequence reserves its first-block length scaled by the bytes of the whole
+ * alignment over those of the first block, so later blocks append without
+ * reallocating. '.' gaps are stored as '-'.
+ */
+class blocks_t {
+   public:
+    blocks_t(sasi::data_t& msa, std::string_view buffer)
+        : msa_{msa}, buffer_{buffer} {}
+
+    void add(std::string_view name, std::string_view seq) {
+        auto [it, inserted] = index_.try_emplace(name, msa_.names.size());
+        if(inserted) {
+            if(index_.size() == 1) {
+                start_ = offset(name);
+            }
+            msa_.names.emplace_back(name);
+            msa_.seqs.emplace_back();
+        } else if(!reserved_) {
+            reserve(offset(name));
+        }
+        std::string& dest = msa_.seqs[it->second];
+        for(char c : seq) {
+            if(!is_blank(c)) {
+                dest.push_back(c == '.' ? GAP : c);
+            }
+        }
+    }
+
+    /** \brief Start a new alignment (Stockholm "//") */
+    void reset() {
+        index_.clear();
+        reserved_ = false;
+        first_ = msa_.seqs.size();
+    }
+
+   private:
+    [[nodiscard]] size_t offset(std::string_view part) const {
+        return static_cast<size_t>(part.data() - buffer_.data());
+    }
+
+    // the first block spans [start_, block_end), the alignment ends at "//"
+    void reserve(size_t block_end) {
+        reserved_ = true;
+        size_t end = std::min(buffer_.find("\n//", block_end), buffer_.size());
+        size_t block = std::max<size_t>(1, block_end - start_);
+        for(size_t i = first_; i < msa_.seqs.size(); ++i) {
+            std::string& seq = msa_.seqs[i];
+            seq.reserve(seq.size() * (end - start_) / block);
+        }
+    }
+
+    sasi::data_t& msa_;
+    std::string_view buffer_;
+    size_t start_{0}; /*!< offset of the first record of the alignment */
+    size_t first_{0};
+    bool reserved_{false};
+    std::unordered_map<std::string_view, size_t> index_;
+};
+}  // namespace
+
+/**
+ * @brief Input format of an extension from `extract_file_type`.
+ *
+ * @details .phy/.phylip: PHYLIP; .sto/.stk/.stockholm: Stockholm;
+ * .aln/.clustal/.clw: Clustal; .a2m/.a3m: A2M/A3M; .fastq/.fq: FASTQ;
+ * anything else FASTA.
+ */
+format input_format(std::string_view type_ext) {
+    std::string ext{type_ext};
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    if(sasi::phylip::is_phylip(ext)) {
+        return format::phylip;
+    }
+    if(ext == ".sto" || ext == ".stk" || ext == ".stockholm") {
+        return format::stockholm;
+    }
+    if(ext == ".aln" || ext == ".clustal" || ext == ".clw") {
+        return format::clustal;
+    }
+    if(ext == ".a2m" || ext == ".a3m") {
+        return format::a3m;
+    }
+    if(ext == ".fastq" || ext == ".fq") {
+        return format::fastq;
+    }
+    return format::fasta;
+}
+
+/**
+ * @brief Parse Stockholm alignments.
+ *
+ * @details "#" lines (header and #=GF/GS/GR/GC markup) are skipped and
+ * sequence lines of interleaved blocks are joined by name. "//" ends an
+ * alignment; records of later alignments are appended. '.' is read as a
+ * gap.
+ */
+void parse_stockholm(std::string_view buffer, sasi::data_t& msa) {
+    blocks_t blocks(msa, buffer);
+    for_each_line(buffer, [&blocks](std::string_view line) {
+        if(line.find_first_not_of(BLANK) == std::string_view::npos ||
+           line[0] == '#') {
+            return;
+        }
+        if(line.substr(0, 2) == "//") {
+            blocks.reset();
+            return;
+        }
+        auto [name, seq] = split_word(line);
+        blocks.add(name, seq);
+    });
+}
+
+/**
+ * @brief Parse a Clustal alignment.
+ *
+ * @details The first line must be a CLUSTAL, MUSCLE or PROBCONS header.
+ * Conservation lines (starting with a blank) and trailing residue counts
+ * are skipped; blocks are joined by sequence name.
+ *
+ * @throws std::invalid_argument if the header is missing.
+ */
+void parse_clustal(std::string_view buffer, sasi::data_t& msa) {
+    bool header{false};
+    blocks_t blocks(msa, buffer);
+    for_each_line(buffer, [&](std::string_view line) {
+        if(line.find_first_not_of(BLANK) == std::string_view::npos) {
+            return;
+        }
+        if(!header) {
+            if(line.substr(0, 7) != "CLUSTAL" &&
+               line.substr(0, 6) != "MUSCLE" &&
+               line.substr(0, 8) != "PROBCONS") {
+                throw std::invalid_argument("Missing Clustal header in " +
+                                            msa.path.string() + ".");
+            }
+            header = true;
+            return;
+        }
+        if(is_blank(line[0])) {
+            return;
+        }
+        auto [name, seq] = split_word(line);
+        // optional cumulative residue count
+        size_t end = seq.find_last_not_of(BLANK);
+        size_t start = seq.find_last_of(BLANK, end);
+        if(end != std::string_view::npos && start != std::string_view::npos) {
+            std::string_view last = seq.substr(start + 1, end - start);
+            if(start > seq.find_first_not_of(BLANK) &&
+               std::all_of(last.begin(), last.end(), [](unsigned char c) {
+                   return std::isdigit(c) != 0;
+               })) {
+                seq = seq.substr(0, start);
+            }
+        }
+        blocks.add(name, seq);
+    });
+}
+
+/**
+ * @brief Parse A2M or A3M: FASTA whose lowercase letters and '.' are
+ * insert states.
+ *
+ * @details Insert columns are skipped while copying, so only the match
+ * columns (uppercase and '-') are stored and records of both formats come
+ * out aligned. "#" lines (A3M metadata) are skipped.
+ *
+ * @throws std::invalid_argument if a record has no match columns or not as
+ * many as the first record of the file.
+ */
+void parse_a3m(std::string_view buffer, sasi::data_t& msa) {
+    bool open{false};
+    size_t first = msa.seqs.size();
+    auto close = [&]() {
+        if(!open) {
+            return;
+        }
+        open = false;
+        const std::string& seq = msa.seqs.back();
+        if(seq.empty()) {
+            throw std::invalid_argument("A2M/A3M record " + msa.names.back() +
+                                        " of " + msa.path.string() +
+                                        " has no match columns.");
+        }
+        if(seq.size() != msa.seqs[first].size()) {
+            throw std::invalid_argument(
+                "A2M/A3M record " + msa.names.back() + " of " +
+                msa.path.string() + " has " + std::to_string(seq.size()) +
+                " match columns, expected " +
+                std::to_string(msa.seqs[first].size()) + ".");
+        }
+    };
+    for_each_line(buffer, [&](std::string_view line) {
+        if(line.empty() || line[0] == '#') {
+            return;
+        }
+        if(line[0] == '>') {
+            close();
+            msa.names.emplace_back(line.substr(1));
+            msa.seqs.emplace_back();
+            open = true;
+            return;
+        }
+        if(!open) {
+            return;
+        }
+        std::string& seq = msa.seqs.back();
+        for(char c : line) {
+            if(std::islower(static_cast<unsigned char>(c)) == 0 && c != '.' &&
+               !is_blank(c)) {
+                seq.push_back(c);
+            }
+        }
+    });
+    close();
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("msa") {
+    std::vector<std::string> names{"seq1", "seq2/10-20"};
+    std::vector<std::string> seqs{"ACG-TACGA-", "AC--TTCGAA"};
+    auto parse = [](void (*parser)(std::string_view, sasi::data_t&),
+                    std::string_view text) {
+        sasi::data_t data("test.aln");
+        parser(text, data);
+        return data;
+    };
+    SUBCASE("formats") {
+        CHECK(input_format(".fasta") == format::fasta);
+        CHECK(input_format("") == format::fasta);
+        CHECK(input_format(".phy") == format::phylip);
+        CHECK(input_format(".STO") == format::stockholm);
+        CHECK(input_format(".stk") == format::stockholm);
+        CHECK(input_format(".aln") == format::clustal);
+        CHECK(input_format(".a2m") == format::a3m);
+        CHECK(input_format(".a3m") == format::a3m);
+        CHECK(input_format(".FQ") == format::fastq);
+    }
+    SUBCASE("stockholm") {
+        auto data = parse(parse_stockholm,
+                          "# STOCKHOLM 1.0\n#=GF ID test\n"
+                          "#=GS seq1 AC P00001\n\n"
+                          "seq1        ACG-T\nseq2/10-20  AC..T\n"
+                          "#=GC SS_cons ....>\n\n"
+                          "seq1        ACGA-\r\nseq2/10-20  TCGAA\n//\n"
+                          "# STOCKHOLM 1.0\nseq1 AAA\n//\n");
+        std::vector<std::string> all_names{names[0], names[1], "seq1"};
+        std::vector<std::string> all_seqs{seqs[0], seqs[1], "AAA"};
+        CHECK(data.names == all_names);
+        CHECK(data.seqs == all_seqs);
+    }
+    SUBCASE("stockholm reservations") {
+        // a small alignment reserves for itself, not for the whole file
+        std::string text{"# STOCKHOLM 1.0\na ACGT\nb AC-T\n\na GG\nb GG\n//\n"
+                         "# STOCKHOLM 1.0\n"};
+        std::string line = "c " + std::string(60, 'A') + "\n";
+        for(size_t i = 0; i < 1000; ++i) {
+            text += line;
+        }
+        text += "//\n";
+        auto data = parse(parse_stockholm, text);
+        REQUIRE(data.seqs.size() == 3);
+        CHECK(data.seqs[0] == "ACGTGG");
+        CHECK(data.seqs[1] == "AC-TGG");
+        CHECK(data.seqs[2] == std::string(60000, 'A'));
+        CHECK(data.seqs[0].capacity() < 100);
+        CHECK(data.seqs[1].capacity() < 100);
+    }
+    SUBCASE("clustal") {
+        auto data = parse(parse_clustal,
+                          "CLUSTAL W (1.83) multiple sequence alignment\n\n"
+                          "seq1        ACG-T 4\nseq2/10-20  AC--T 3\n"
+                          "            ** *\n\n"
+                          "seq1        ACGA- 8\nseq2/10-20  TCGAA 8\n");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+        CHECK_THROWS_AS(parse(parse_clustal, "seq1 ACGT\n"),
+                        std::invalid_argument);
+    }
+    SUBCASE("a3m and a2m") {
+        std::string_view a3m{
+            "#A3M#\n>seq1\nACgG-TAcCGA-\n>seq2/10-20\nAC--TTCGAA\n"};
+        std::string_view a2m{
+            ">seq1\nACgG-TAcCGA-\n>seq2/10-20\nAC..--TT.CGAA\n"};
+        for(auto text : {a3m, a2m}) {
+            auto data = parse(parse_a3m, text);
+            CHECK(data.names == names);
+            CHECK(data.seqs == seqs);
+        }
+        CHECK_THROWS_AS(parse(parse_a3m, ">a\nACGT\n>empty\nacg\n"),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(parse(parse_a3m, ">a\nACGT\n>b\nACgGT-\n"),
+                        std::invalid_argument);
+    }
+    SUBCASE("read_fasta dispatch") {
+        std::ofstream out;
+        out.open("test-msa.txt");
+        REQUIRE(out);
+        out << "# STOCKHOLM 1.0\nseq1 ACG-TACGA-\nseq2/10-20 AC--TTCGAA\n//\n";
+        out.close();
+        auto data = sasi::fasta::read_fasta("sto:test-msa.txt");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+        REQUIRE(std::filesystem::remove("test-msa.txt"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::msa
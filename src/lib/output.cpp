@@ -2,7 +2,14 @@
 
 #include <doctest.h>
 
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <cmath>
 #include <sasi/output.hpp>
+#include <sasi/phylip.hpp>
+#include <sasi/profile.hpp>
+#include <sstream>
 
 namespace sasi::gap::output {
 
@@ -11,6 +18,7 @@ namespace sasi::gap::output {
  */
 void frequency(const std::vector<std::pair<size_t, size_t>>& counts,
                std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::frequency"};
     // if no gaps, print 1 gap of length zero
     if(counts.empty()) {
         out << "Gap_length,count" << std::endl;
@@ -23,10 +31,21 @@ void frequency(const std::vector<std::pair<size_t, size_t>>& counts,
     }
 }
 
+/**
+ * @brief Write result from gap::histogram with the binning of args.
+ */
+void histogram(const sasi::hist::histogram_t& hist, const sasi::args_t& args,
+               std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::histogram"};
+    sasi::hist::write(hist, sasi::hist::parse_binning(args.bins),
+                      args.bin_width, args.zeros, "Gap_length", out);
+}
+
 /**
  * @brief Write result from gap::frameshift to file or stdout.
  */
 void frameshift(const std::pair<size_t, size_t>& gaps, std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::frameshift"};
     out << "frameshifting-gaps,total-gaps" << std::endl
         << gaps.first << "," << gaps.second << std::endl;
 }
@@ -35,6 +54,7 @@ void frameshift(const std::pair<size_t, size_t>& gaps, std::ostream& out) {
  * @brief Write result from gap::phase to file or stdout.
  */
 void phase(const std::vector<std::vector<size_t>>& phases, std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::phase"};
     // write counts to stdout
     out << "phase0,phase1,phase2" << std::endl;
     for(auto file : phases) {
@@ -42,10 +62,24 @@ void phase(const std::vector<std::vector<size_t>>& phases, std::ostream& out) {
     }
 }
 
+/**
+ * @brief Write result from gap::phase_range to file or stdout.
+ */
+void phase_range(const std::vector<std::vector<size_t>>& phases, size_t k_min,
+                 std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::phase_range"};
+    out << "k,phase0,phase1,phase2" << std::endl;
+    for(size_t i = 0; i < phases.size(); ++i) {
+        out << k_min + i << "," << phases[i][0] << "," << phases[i][1] << ","
+            << phases[i][2] << std::endl;
+    }
+}
+
 /**
  * @brief Write result from gap::position to file or stdout.
  */
 void position(const std::vector<size_t>& positions, std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::position"};
     // if no gaps, print 1 gap of length zero
     auto any_gaps = std::find_if(begin(positions), end(positions),
                                  [](size_t s) { return s > 0; });
@@ -60,6 +94,95 @@ void position(const std::vector<size_t>& positions, std::ostream& out) {
     }
 }
 
+/**
+ * @brief Write result from gap::joint to file or stdout.
+ *
+ * @details Sparse encoding: one row per non-empty cell, position is the
+ * lower bound (%) of the position bin.
+ */
+void joint(const std::vector<sasi::gap_cell_t>& cells, std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::joint"};
+    out << "length,phase,position,count" << std::endl;
+    for(const auto& cell : cells) {
+        out << cell.length << "," << cell.phase << "," << cell.position << ","
+            << cell.count << std::endl;
+    }
+}
+
+/**
+ * @brief Write result from gap::indels to file or stdout.
+ */
+void indels(const std::vector<sasi::indel_t>& indels,
+            const std::vector<std::string>& files, std::ostream& out) {
+    sasi::profile::scope prof{"output::gap::indels"};
+    out << "filename,start,length,support" << std::endl;
+    for(const auto& indel : indels) {
+        out << files[indel.file] << ',' << indel.start << ',' << indel.length
+            << ',' << indel.support << '\n';
+    }
+    out.flush();
+}
+
+/**
+ * @brief Start the output of gap::events with the table of input files.
+ *
+ * @details "csv" writes one "# file <index>: <name>" line per input file
+ * and the column names. "binary" writes the "SASIGAP1" magic, the number of
+ * files and each file name as a uint64 length and its bytes, followed by
+ * one 34-byte row per gap (see `event`).
+ */
+void events_header(const std::string& format,
+                   const std::vector<std::string>& files, std::ostream& out) {
+    if(format == "binary") {
+        out.write("SASIGAP1", 8);
+        auto write_u64 = [&out](std::uint64_t value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+        write_u64(files.size());
+        for(const auto& file : files) {
+            write_u64(file.size());
+            out.write(file.data(), static_cast<std::streamsize>(file.size()));
+        }
+    } else {
+        for(size_t i = 0; i < files.size(); ++i) {
+            out << "# file " << i << ": " << files[i] << '\n';
+        }
+        out << "file,record,start,length,phase,frameshift\n";
+    }
+}
+
+/**
+ * @brief Write one gap from gap::events.
+ *
+ * @details Binary rows hold file, record, start and length (uint64), phase
+ * and frameshift flag (uint8), in host byte order.
+ */
+void event(const sasi::gap_event_t& event, const std::string& format,
+           std::ostream& out) {
+    if(format != "binary") {
+        // formatted by hand, ostream insertion dominates for large outputs
+        std::array<char, 128> row{};
+        char* pos = row.data();
+        char* end = row.data() + row.size();
+        for(size_t value : {event.file, event.record, event.start,
+                            event.length, event.phase}) {
+            pos = std::to_chars(pos, end, value).ptr;
+            *pos++ = ',';
+        }
+        *pos++ = event.frameshift ? '1' : '0';
+        *pos++ = '\n';
+        out.write(row.data(), pos - row.data());
+        return;
+    }
+    std::array<char, 34> row{};
+    std::array<std::uint64_t, 4> fields{event.file, event.record, event.start,
+                                        event.length};
+    std::memcpy(row.data(), fields.data(), sizeof(fields));
+    row[32] = static_cast<char>(event.phase);
+    row[33] = static_cast<char>(event.frameshift);
+    out.write(row.data(), row.size());
+}
+
 }  // namespace sasi::gap::output
 
 namespace sasi::seq::output {
@@ -68,14 +191,25 @@ namespace sasi::seq::output {
  * @brief Write result from seq::ambiguous to file or stdout.
  */
 void ambiguous(const size_t count, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::ambiguous"};
     out << "ambiguous_nucleotides" << std::endl;
     out << count << std::endl;
 }
 
+/**
+ * @brief Write result from seq::ambiguous_quality to file or stdout.
+ */
+void ambiguous(const std::pair<size_t, size_t> counts, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::ambiguous"};
+    out << "ambiguous_nucleotides,low_quality_bases" << std::endl;
+    out << counts.first << "," << counts.second << std::endl;
+}
+
 /**
  * @brief Write result from seq::frameshift to file or stdout.
  */
 void frameshift(const std::pair<size_t, size_t> count, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::frameshift"};
     out << "frameshifts,total" << std::endl;
     out << count.first << "," << count.second << std::endl;
 }
@@ -84,16 +218,251 @@ void frameshift(const std::pair<size_t, size_t> count, std::ostream& out) {
  * @brief Write result from seq::stop_codons to file or stdout.
  */
 void stop_codons(const std::vector<std::string>& count, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::stop_codons"};
     for(const auto& line : count) {
         out << line << std::endl;
     }
 }
 
 void subst(const std::vector<std::size_t>& count, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::subst"};
     out << "phase0,phase1,phase2" << std::endl
         << count[0] << ',' << count[1] << ',' << count[2] << std::endl;
 }
 
+/**
+ * @brief Write result from seq::subst_matrix to file or stdout.
+ *
+ * @details One row per phase; column XY counts base X in the first sequence
+ * aligned to Y in the second, N standing for any non-ACGT character.
+ */
+void subst_matrix(const sasi::seq::subst_matrix_t& matrix, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::subst_matrix"};
+    constexpr std::string_view bases{"ACGTN"};
+    out << "phase";
+    for(char a : bases) {
+        for(char b : bases) {
+            out << ',' << a << b;
+        }
+    }
+    out << ",transitions,transversions" << std::endl;
+    for(size_t p = 0; p < 3; ++p) {
+        out << p;
+        for(const auto& row : matrix.counts[p]) {
+            for(size_t count : row) {
+                out << ',' << count;
+            }
+        }
+        out << ',' << matrix.transitions(p) << ',' << matrix.transversions(p)
+            << std::endl;
+    }
+}
+
+/**
+ * @brief Write result from seq::composition to file or stdout.
+ *
+ * @details `quality` adds the low_quality column.
+ */
+void composition(
+    const std::vector<std::pair<std::string, sasi::seq::composition_t>>& rows,
+    sasi::info_detail detail, std::ostream& out, bool quality) {
+    sasi::profile::scope prof{"output::seq::composition"};
+    if(detail == sasi::info_detail::FILE) {
+        out << "filename,";
+    } else if(detail == sasi::info_detail::SEQ) {
+        out << "filename,seqname,";
+    }
+    out << "A,C,G,T,gaps,ambiguous,other,gc_content";
+    if(quality) {
+        out << ",low_quality";
+    }
+    out << std::endl;
+    for(const auto& [label, comp] : rows) {
+        if(detail != sasi::info_detail::TOTAL) {
+            out << label << ',';
+        }
+        out << comp.a << ',' << comp.c << ',' << comp.g << ',' << comp.t << ','
+            << comp.gaps << ',' << comp.ambiguous << ',' << comp.other << ','
+            << comp.gc_content();
+        if(quality) {
+            out << ',' << comp.low_quality;
+        }
+        out << std::endl;
+    }
+}
+
+/**
+ * @brief Write result from seq::codons to file or stdout.
+ *
+ * @details One row per codon, or per amino acid with `args.amino_acids`,
+ * for each total, file or sequence row.
+ */
+void codons(
+    const std::vector<std::pair<std::string, sasi::seq::codon_counts_t>>& rows,
+    const sasi::args_t& args, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::codons"};
+    const std::string code = sasi::seq::genetic_code(args.genetic_code);
+    if(args.codon_inf == sasi::info_detail::FILE) {
+        out << "filename,";
+    } else if(args.codon_inf == sasi::info_detail::SEQ) {
+        out << "filename,seqname,";
+    }
+    if(args.amino_acids) {
+        out << "amino_acid,count" << std::endl;
+    } else {
+        out << "codon,amino_acid,count" << (args.rscu ? ",rscu" : "")
+            << std::endl;
+    }
+    for(const auto& [label, counts] : rows) {
+        std::string prefix =
+            args.codon_inf == sasi::info_detail::TOTAL ? "" : label + ",";
+        if(args.amino_acids) {
+            for(const auto& [aa, count] :
+                sasi::seq::amino_acid_counts(counts, code)) {
+                out << prefix << aa << ',' << count << '\n';
+            }
+            continue;
+        }
+        std::array<double, sasi::seq::N_CODONS> values{};
+        if(args.rscu) {
+            values = sasi::seq::rscu(counts, code);
+        }
+        for(size_t i = 0; i < sasi::seq::N_CODONS; ++i) {
+            out << prefix << sasi::seq::codon_name(i) << ',' << code[i] << ','
+                << counts.counts[i];
+            if(args.rscu) {
+                out << ',' << values[i];
+            }
+            out << '\n';
+        }
+    }
+    out.flush();
+}
+
+/**
+ * @brief Write result from seq::distance to file or stdout.
+ *
+ * @details "phylip": square p-distance matrix per alignment, preceded by
+ * the number of sequences, in strict PHYLIP layout: names made unique
+ * within `phylip::STRICT_NAME` columns (`phylip::strict_names`) and padded
+ * with blanks, and -1 for pairs without comparable sites. "binary": per
+ * alignment, "SASIDST2", the number of sequences n (uint64), n names
+ * (uint64 length and bytes), the condensed upper triangle as n(n-1)/2
+ * doubles (NaN for pairs without comparable sites) and then as n(n-1)/2
+ * shared gap counts (uint64), in host byte order.
+ */
+void distance(const std::vector<sasi::seq::distance_matrix_t>& matrices,
+              const std::string& format, std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::distance"};
+    auto write_u64 = [&out](std::uint64_t value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    for(const auto& dist : matrices) {
+        size_t n = dist.names.size();
+        if(format == "binary") {
+            out.write("SASIDST2", 8);
+            write_u64(n);
+            for(const auto& name : dist.names) {
+                write_u64(name.size());
+                out.write(name.data(),
+                          static_cast<std::streamsize>(name.size()));
+            }
+            for(size_t i = 0; i < n; ++i) {
+                for(size_t j = i + 1; j < n; ++j) {
+                    double p = dist.p(i, j);
+                    out.write(reinterpret_cast<const char*>(&p), sizeof(p));
+                }
+            }
+            for(size_t gaps : dist.gaps) {
+                write_u64(gaps);
+            }
+            continue;
+        }
+        std::vector<std::string> names = sasi::phylip::strict_names(dist.names);
+        out << n << '\n';
+        for(size_t i = 0; i < n; ++i) {
+            std::string& name = names[i];
+            name.resize(sasi::phylip::STRICT_NAME, ' ');
+            out << name;
+            for(size_t j = 0; j < n; ++j) {
+                double p = dist.p(i, j);
+                out << ' ' << (std::isnan(p) ? -1.0 : p);
+            }
+            out << '\n';
+        }
+    }
+    out.flush();
+}
+
+/**
+ * @brief Write result from seq::duplicates to file or stdout.
+ */
+void duplicates(
+    const std::vector<std::pair<std::string, std::vector<std::string>>>& groups,
+    std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::duplicates"};
+    out << "filename,copies,seqnames" << std::endl;
+    for(const auto& [file, names] : groups) {
+        out << file << ',' << names.size() << ',';
+        for(size_t i = 0; i < names.size(); ++i) {
+            out << (i > 0 ? ";" : "") << names[i];
+        }
+        out << '\n';
+    }
+    out.flush();
+}
+
+/**
+ * @brief Write amino acid counts of seq::translate to file or stdout.
+ */
+void residues(
+    const std::vector<std::pair<std::string, sasi::seq::residue_counts_t>>&
+        rows,
+    std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::residues"};
+    out << "filename,amino_acid,count" << std::endl;
+    for(const auto& [file, counts] : rows) {
+        for(size_t c = 0; c < counts.size(); ++c) {
+            if(counts[c] > 0) {
+                out << file << ',' << static_cast<char>(c) << ','
+                    << counts[c] << '\n';
+            }
+        }
+    }
+    out.flush();
+}
+
+/**
+ * @brief Start the output of seq::window.
+ */
+void window_header(std::ostream& out) {
+    out << "filename,seqname,start,end,gaps,ambiguous,gc" << std::endl;
+}
+
+/**
+ * @brief Write the windows of one sequence from seq::window.
+ *
+ * @details Windows are 0-based, half-open [start, end) and start every
+ * `step` positions inside the sequence; the last window is cut at the end
+ * of the sequence. With `step` > `size` the positions between windows are
+ * skipped.
+ */
+void window(const std::string& file, const std::string& name,
+            const sasi::seq::prefix_counts_t& sums, size_t size, size_t step,
+            std::ostream& out) {
+    sasi::profile::scope prof{"output::seq::window"};
+    for(size_t start = 0; start < sums.size(); start += step) {
+        size_t end = std::min(start + size, sums.size());
+        auto counts = sums.count(start, end);
+        out << file << ',' << name << ',' << start << ',' << end << ','
+            << counts.gaps << ',' << counts.ambiguous << ',' << counts.gc
+            << '\n';
+        if(end == sums.size()) {
+            break;
+        }
+    }
+}
+
 TEST_CASE("output") {
     auto test = [](const std::vector<std::string>& expected) {
         std::ifstream in;
@@ -126,6 +495,22 @@ TEST_CASE("output") {
         sasi::gap::output::frequency(counts, outfile);
         test(expected);
     }
+    SUBCASE("gap histogram") {
+        sasi::hist::histogram_t hist;
+        hist.add(2, 3);
+        hist.add(7);
+        sasi::args_t args;
+        args.bins = "linear";
+        args.bin_width = 5;
+        args.zeros = true;
+        std::vector<std::string> expected{"Gap_length_min,Gap_length_max,count",
+                                          "0,4,3", "5,9,1"};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::gap::output::histogram(hist, args, outfile);
+        test(expected);
+    }
     SUBCASE("gap frameshift") {
         std::pair<size_t, size_t> gaps{10, 30};
         std::vector<std::string> expected{"frameshifting-gaps,total-gaps",
@@ -156,6 +541,270 @@ TEST_CASE("output") {
         sasi::gap::output::phase(gaps, outfile);
         test(expected);
     }
+    SUBCASE("gap phase range") {
+        std::vector<std::vector<size_t>> gaps{{30, 20, 10}, {5, 2, 3}};
+        std::vector<std::string> expected{
+            {"k,phase0,phase1,phase2"}, {"2,30,20,10"}, {"3,5,2,3"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::gap::output::phase_range(gaps, 2, outfile);
+        test(expected);
+    }
+    SUBCASE("sequence composition") {
+        std::vector<std::pair<std::string, sasi::seq::composition_t>> rows{
+            {"f.fa,s1", {1, 1, 2, 0, 3, 0, 0}}, {"f.fa,s2", {}}};
+        std::vector<std::string> expected{
+            {"filename,seqname,A,C,G,T,gaps,ambiguous,other,gc_content"},
+            {"f.fa,s1,1,1,2,0,3,0,0,0.75"},
+            {"f.fa,s2,0,0,0,0,0,0,0,0"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::composition(rows, sasi::info_detail::SEQ, outfile);
+        test(expected);
+    }
+    SUBCASE("sequence composition - low quality") {
+        std::vector<std::pair<std::string, sasi::seq::composition_t>> rows{
+            {"", {1, 1, 2, 0, 3, 0, 0, 4}}};
+        std::vector<std::string> expected{
+            {"A,C,G,T,gaps,ambiguous,other,gc_content,low_quality"},
+            {"1,1,2,0,3,0,0,0.75,4"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::composition(rows, sasi::info_detail::TOTAL, outfile,
+                                       true);
+        test(expected);
+    }
+    SUBCASE("sequence subst matrix") {
+        sasi::seq::subst_matrix_t matrix;
+        matrix.counts[0][0][0] = 5;
+        matrix.counts[0][0][2] = 2;
+        matrix.counts[1][1][0] = 1;
+        auto zeros = [](size_t n) {
+            std::string ret;
+            for(size_t i = 0; i < n; ++i) {
+                ret += ",0";
+            }
+            return ret;
+        };
+        std::vector<std::string> expected{
+            {"phase,AA,AC,AG,AT,AN,CA,CC,CG,CT,CN,GA,GC,GG,GT,GN,TA,TC,TG,TT,"
+             "TN,NA,NC,NG,NT,NN,transitions,transversions"},
+            {"0,5,0,2" + zeros(22) + ",2,0"},
+            {"1" + zeros(5) + ",1" + zeros(19) + ",0,1"},
+            {"2" + zeros(27)}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::subst_matrix(matrix, outfile);
+        test(expected);
+    }
+    SUBCASE("sequence distance") {
+        sasi::seq::distance_matrix_t dist;
+        dist.mismatches = {1, 0, 3};
+        dist.compared = {4, 0, 6};
+        dist.gaps = {0, 2, 1};
+        dist.names = {"a", "b", "sequence_long_name"};
+        std::vector<std::string> expected{{"3"},
+                                          {"a          0 0.25 -1"},
+                                          {"b          0.25 0 0.5"},
+                                          {"sequence_l -1 0.5 0"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::distance({dist}, "phylip", outfile);
+        outfile.close();
+        test(expected);
+
+        dist.names = {"a", "b", "c"};
+        outfile.open("test.bin", std::ios::binary);
+        REQUIRE(outfile);
+        sasi::seq::output::distance({dist}, "binary", outfile);
+        outfile.close();
+        std::ifstream in("test.bin", std::ios::binary);
+        std::string bytes{std::istreambuf_iterator<char>(in),
+                          std::istreambuf_iterator<char>()};
+        in.close();
+        REQUIRE(bytes.size() == 8 + 8 + 3 * 9 + 3 * 8 + 3 * 8);
+        CHECK(bytes.substr(0, 8) == "SASIDST2");
+        double p{0};
+        std::memcpy(&p, bytes.data() + 8 + 8 + 3 * 9 + 2 * 8, sizeof(p));
+        CHECK(p == doctest::Approx(0.5));
+        std::memcpy(&p, bytes.data() + 8 + 8 + 3 * 9 + 8, sizeof(p));
+        CHECK(std::isnan(p));
+        std::uint64_t gaps{0};
+        std::memcpy(&gaps, bytes.data() + 8 + 8 + 3 * 9 + 3 * 8 + 8,
+                    sizeof(gaps));
+        CHECK(gaps == 2);
+        REQUIRE(std::filesystem::remove("test.bin"));
+    }
+    SUBCASE("sequence codons") {
+        sasi::seq::codon_counts_t counts;
+        counts.counts[0] = 3;  // AAA
+        counts.counts[2] = 1;  // AAG
+        std::vector<std::pair<std::string, sasi::seq::codon_counts_t>> rows{
+            {"f.fa", counts}};
+        sasi::args_t args;
+        args.codon_inf = sasi::info_detail::FILE;
+        args.rscu = true;
+        std::vector<std::string> expected{
+            {"filename,codon,amino_acid,count,rscu"},
+            {"f.fa,AAA,K,3,1.5"},
+            {"f.fa,AAC,N,0,0"},
+            {"f.fa,AAG,K,1,0.5"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::codons(rows, args, outfile);
+        outfile.close();
+        test(expected);
+
+        args.amino_acids = true;
+        args.codon_inf = sasi::info_detail::TOTAL;
+        expected = {{"amino_acid,count"}, {"*,0"}, {"A,0"}};
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::codons(rows, args, outfile);
+        test(expected);
+    }
+    SUBCASE("sequence duplicates") {
+        std::vector<std::pair<std::string, std::vector<std::string>>> groups{
+            {"f.fa", {"a", "c"}}, {"g.fa", {"x", "y", "z"}}};
+        std::vector<std::string> expected{
+            {"filename,copies,seqnames"}, {"f.fa,2,a;c"}, {"g.fa,3,x;y;z"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::duplicates(groups, outfile);
+        test(expected);
+    }
+    SUBCASE("sequence residues") {
+        sasi::seq::residue_counts_t counts{};
+        counts['M'] = 2;
+        counts['*'] = 1;
+        std::vector<std::pair<std::string, sasi::seq::residue_counts_t>> rows{
+            {"f.fa", counts}};
+        std::vector<std::string> expected{{"filename,amino_acid,count"},
+                                          {"f.fa,*,1"},
+                                          {"f.fa,M,2"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::residues(rows, outfile);
+        test(expected);
+    }
+    SUBCASE("sequence window") {
+        sasi::seq::prefix_counts_t sums;
+        sums.build("AC-GN-NNgc");
+        std::vector<std::string> expected{
+            {"filename,seqname,start,end,gaps,ambiguous,gc"},
+            {"f.fa,s1,0,4,1,0,2"},
+            {"f.fa,s1,3,7,1,2,1"},
+            {"f.fa,s1,6,10,0,2,2"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::window_header(outfile);
+        sasi::seq::output::window("f.fa", "s1", sums, 4, 3, outfile);
+        outfile.close();
+        test(expected);
+    }
+    SUBCASE("sequence window - step larger than size") {
+        sasi::seq::prefix_counts_t sums;
+        sums.build("AC-GN-NNgc");
+        std::ostringstream out;
+        sasi::seq::output::window("f.fa", "s1", sums, 2, 6, out);
+        CHECK(out.str() == "f.fa,s1,0,2,0,0,1\nf.fa,s1,6,8,0,2,0\n");
+        out.str("");
+        // step does not divide the length: no empty window at the end
+        sasi::seq::output::window("f.fa", "s1", sums, 4, 5, out);
+        CHECK(out.str() == "f.fa,s1,0,4,1,0,2\nf.fa,s1,5,9,1,2,1\n");
+    }
+    SUBCASE("sequence window - command line") {
+        std::ofstream fasta("test-window-cli.fa");
+        REQUIRE(fasta);
+        fasta << ">s1\nAC-GN-NNgc\n";
+        fasta.close();
+        CLI::App app;
+        sasi::args_t args = sasi::utils::set_cli_options(app);
+        app.parse("sequence window --size 2 --step 6 test-window-cli.fa",
+                  false);
+        std::ostringstream out;
+        sasi::seq::window(args, [&](const std::string& file,
+                                    const std::string& name,
+                                    const sasi::seq::prefix_counts_t& sums) {
+            sasi::seq::output::window(file, name, sums, args.window_size,
+                                      args.window_step, out);
+        });
+        CHECK(out.str() ==
+              "test-window-cli.fa,s1,0,2,0,0,1\n"
+              "test-window-cli.fa,s1,6,8,0,2,0\n");
+        REQUIRE(std::filesystem::remove("test-window-cli.fa"));
+    }
+    SUBCASE("gap indels") {
+        std::vector<sasi::indel_t> indels{{0, 2, 2, 3}, {1, 0, 4, 1}};
+        std::vector<std::string> expected{{"filename,start,length,support"},
+                                          {"a.fa,2,2,3"},
+                                          {"b.fa,0,4,1"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::gap::output::indels(indels, {"a.fa", "b.fa"}, outfile);
+        test(expected);
+    }
+    SUBCASE("gap events") {
+        std::vector<sasi::gap_event_t> events{{0, 1, 5, 2, 2, true},
+                                              {1, 0, 9, 3, 0, false}};
+        std::vector<std::string> files{"a.fa", "b.fa"};
+        std::vector<std::string> expected{
+            {"# file 0: a.fa"},
+            {"# file 1: b.fa"},
+            {"file,record,start,length,phase,frameshift"},
+            {"0,1,5,2,2,1"},
+            {"1,0,9,3,0,0"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::gap::output::events_header("csv", files, outfile);
+        for(const auto& e : events) {
+            sasi::gap::output::event(e, "csv", outfile);
+        }
+        outfile.close();
+        test(expected);
+
+        std::ostringstream bin;
+        sasi::gap::output::events_header("binary", files, bin);
+        for(const auto& e : events) {
+            sasi::gap::output::event(e, "binary", bin);
+        }
+        std::string bytes = bin.str();
+        // magic, number of files, two (length, name) entries
+        size_t rows = 8 + 8 + 2 * (8 + 4);
+        REQUIRE(bytes.size() == rows + 2 * 34);
+        CHECK(bytes.substr(0, 8) == "SASIGAP1");
+        CHECK(bytes.substr(8 + 8 + 8 + 4 + 8, 4) == "b.fa");
+        std::uint64_t value{0};
+        std::memcpy(&value, bytes.data() + 8, 8);
+        CHECK(value == 2);
+        std::memcpy(&value, bytes.data() + rows + 34, 8);
+        CHECK(value == 1);
+        std::memcpy(&value, bytes.data() + rows + 34 + 16, 8);
+        CHECK(value == 9);
+        CHECK(bytes[rows + 32] == 2);
+        CHECK(bytes[rows + 33] == 1);
+    }
+    SUBCASE("gap joint") {
+        std::vector<sasi::gap_cell_t> cells{{1, 2, 20, 4}, {3, 0, 95, 1}};
+        std::vector<std::string> expected{
+            {"length,phase,position,count"}, {"1,2,20,4"}, {"3,0,95,1"}};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::gap::output::joint(cells, outfile);
+        test(expected);
+    }
     SUBCASE("gap position") {
         std::vector<size_t> positions{
             0, 2, 1, 1, 2, 3, 1, 2, 3, 1, 4, 3, 4, 2, 2, 2, 2, 2, 4, 1, 2,
@@ -288,6 +937,16 @@ TEST_CASE("output") {
         sasi::seq::output::ambiguous(count, outfile);
         test(expected);
     }
+    SUBCASE("sequence ambiguous - low quality") {
+        std::vector<std::string> expected{
+            "ambiguous_nucleotides,low_quality_bases", "10,3"};
+        std::ofstream outfile;
+        outfile.open("test.txt");
+        REQUIRE(outfile);
+        sasi::seq::output::ambiguous(std::make_pair(size_t{10}, size_t{3}),
+                                     outfile);
+        test(expected);
+    }
     SUBCASE("sequence frameshift") {
         std::pair<size_t, size_t> count{9, 25};
         std::vector<std::string> expected{"frameshifts,total", "9,25"};
@@ -0,0 +1,198 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <sasi/perf.hpp>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace sasi::perf {
+
+namespace {
+std::atomic<bool> g_enabled{false};
+std::mutex g_error_mutex;
+std::string g_error;
+
+void set_error(std::string msg) {
+    std::lock_guard<std::mutex> lock(g_error_mutex);
+    g_error = std::move(msg);
+}
+
+#if defined(__linux__)
+constexpr size_t N_EVENTS{4};
+constexpr std::array<std::uint64_t, N_EVENTS> EVENTS{
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+int open_event(std::uint64_t config, int group) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group,
+                                    PERF_FLAG_FD_CLOEXEC));
+}
+
+// one counter group per thread; the cycles counter is the group leader
+struct group_t {
+    std::array<int, N_EVENTS> fds{-1, -1, -1, -1};
+    std::array<int, N_EVENTS> slot{-1, -1, -1, -1};
+    size_t members{0};
+    bool tried{false};
+    bool ok{false};
+
+    group_t() = default;
+    group_t(const group_t&) = delete;
+    group_t& operator=(const group_t&) = delete;
+    group_t(group_t&&) = delete;
+    group_t& operator=(group_t&&) = delete;
+    ~group_t() {
+        for(int fd : fds) {
+            if(fd != -1) {
+                close(fd);
+            }
+        }
+    }
+
+    bool open() {
+        if(tried) {
+            return ok;
+        }
+        tried = true;
+        fds[0] = open_event(EVENTS[0], -1);
+        if(fds[0] == -1) {
+            set_error(std::string{"perf_event_open: "} + std::strerror(errno));
+            return false;
+        }
+        slot[0] = static_cast<int>(members++);
+        // missing members (e.g. no cache events in a VM) are reported as 0
+        for(size_t i = 1; i < N_EVENTS; ++i) {
+            fds[i] = open_event(EVENTS[i], fds[0]);
+            if(fds[i] != -1) {
+                slot[i] = static_cast<int>(members++);
+            }
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        ok = true;
+        return ok;
+    }
+};
+
+thread_local group_t t_group;
+#endif
+}  // namespace
+
+/**
+ * @brief Turn hardware counters on or off.
+ *
+ * @details Opens the counter group of the calling thread to check that the
+ * kernel allows it (see perf_event_paranoid). Other threads open their own
+ * group on first `read`.
+ *
+ * @return false if counters are unavailable; `error` gives the reason.
+ */
+bool enable(bool on) {
+    if(!on) {
+        g_enabled.store(false, std::memory_order_relaxed);
+        return true;
+    }
+#if defined(__linux__)
+    if(!t_group.open()) {
+        return false;
+    }
+    g_enabled.store(true, std::memory_order_relaxed);
+    return true;
+#else
+    set_error("hardware counters require Linux perf_event_open");
+    return false;
+#endif
+}
+
+bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+std::string error() {
+    std::lock_guard<std::mutex> lock(g_error_mutex);
+    return g_error;
+}
+
+/**
+ * @brief Read the counters of the calling thread.
+ *
+ * @details Values are scaled by enabled/running time when the kernel
+ * multiplexes the group.
+ */
+bool read(counters_t& counters) {
+#if defined(__linux__)
+    if(!enabled() || !t_group.open()) {
+        return false;
+    }
+    // nr, time_enabled, time_running, values[nr]
+    std::array<std::uint64_t, 3 + N_EVENTS> buf{};
+    ssize_t n = ::read(t_group.fds[0], buf.data(), sizeof(buf));
+    if(n < static_cast<ssize_t>(3 * sizeof(std::uint64_t))) {
+        return false;
+    }
+    double scale{1.0};
+    if(buf[2] > 0 && buf[2] < buf[1]) {
+        scale = static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+    }
+    auto value = [&](size_t event) -> std::uint64_t {
+        int s = t_group.slot[event];
+        if(s < 0 || static_cast<std::uint64_t>(s) >= buf[0]) {
+            return 0;
+        }
+        return static_cast<std::uint64_t>(
+            static_cast<double>(buf[3 + static_cast<size_t>(s)]) * scale);
+    };
+    counters.cycles = value(0);
+    counters.instructions = value(1);
+    counters.cache_misses = value(2);
+    counters.branch_misses = value(3);
+    return true;
+#else
+    (void)counters;
+    return false;
+#endif
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("perf") {
+    counters_t before;
+    if(!enable(true)) {
+        // unavailable (paranoid kernel, container, non-Linux): degrade
+        CHECK_FALSE(enabled());
+        CHECK_FALSE(error().empty());
+        CHECK_FALSE(read(before));
+        return;
+    }
+    REQUIRE(read(before));
+    volatile std::uint64_t sum{0};
+    for(std::uint64_t i = 0; i < 100000; ++i) {
+        sum = sum + i;
+    }
+    counters_t after;
+    REQUIRE(read(after));
+    enable(false);
+    CHECK(after.cycles >= before.cycles);
+    CHECK(after.instructions > before.instructions);
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::perf
@@ -0,0 +1,295 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <sasi/fasta.hpp>
+#include <sasi/phylip.hpp>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace sasi::phylip {
+
+namespace {
+constexpr std::string_view BLANK{" \t\r\v\f"};
+
+// next line with a non-blank character at or after pos; pos moves past it
+bool next_line(std::string_view buffer, size_t& pos, std::string_view& line) {
+    while(pos < buffer.size()) {
+        size_t eol = buffer.find('\n', pos);
+        if(eol == std::string_view::npos) {
+            eol = buffer.size();
+        }
+        line = buffer.substr(pos, eol - pos);
+        pos = eol + 1;
+        if(line.find_first_not_of(BLANK) != std::string_view::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// append the characters of part that are not whitespace
+void append_bases(std::string& seq, std::string_view part) {
+    for(char c : part) {
+        if(std::isspace(static_cast<unsigned char>(c)) == 0) {
+            seq.push_back(c);
+        }
+    }
+}
+
+// number of characters of part that are not whitespace
+size_t count_bases(std::string_view part) {
+    return static_cast<size_t>(
+        std::count_if(part.begin(), part.end(), [](char c) {
+            return std::isspace(static_cast<unsigned char>(c)) == 0;
+        }));
+}
+
+// name and sequence part of the first line of a taxon: the name is the
+// first word, or the first 10 columns if the line has no blank (strict)
+std::pair<std::string_view, std::string_view> split_name(
+    std::string_view line) {
+    line.remove_prefix(line.find_first_not_of(BLANK));
+    size_t end = line.find_first_of(BLANK);
+    if(end == std::string_view::npos) {
+        end = std::min(STRICT_NAME, line.size());
+    }
+    return {line.substr(0, end), line.substr(end)};
+}
+
+// read a non-negative integer after optional blanks
+bool read_size(std::string_view line, size_t& pos, size_t& value) {
+    pos = line.find_first_not_of(BLANK, pos);
+    if(pos == std::string_view::npos) {
+        return false;
+    }
+    auto [end, ec] = std::from_chars(line.data() + pos,
+                                     line.data() + line.size(), value);
+    pos = static_cast<size_t>(end - line.data());
+    return ec == std::errc{};
+}
+}  // namespace
+
+/**
+ * @brief Whether an extension from `extract_file_type` names PHYLIP.
+ */
+bool is_phylip(std::string_view type_ext) {
+    std::string ext{type_ext};
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return ext == ".phy" || ext == ".phylip";
+}
+
+/**
+ * @brief Names cut to `STRICT_NAME` columns without duplicates.
+ *
+ * @details A name whose first columns are already taken ends in "_1",
+ * "_2", ... instead, so truncated names still identify one taxon each.
+ */
+std::vector<std::string> strict_names(const std::vector<std::string>& names) {
+    std::vector<std::string> ret;
+    ret.reserve(names.size());
+    std::unordered_set<std::string> taken;
+    for(const auto& name : names) {
+        std::string strict = name.substr(0, STRICT_NAME);
+        for(size_t k = 1; taken.count(strict) > 0; ++k) {
+            std::string suffix = "_" + std::to_string(k);
+            strict = name.substr(0, STRICT_NAME - suffix.size()) + suffix;
+        }
+        taken.insert(strict);
+        ret.push_back(std::move(strict));
+    }
+    return ret;
+}
+
+namespace {
+// whether the body at pos is sequential, decided from its first lines:
+// the first taxon must have exactly nchar characters on its own lines,
+// unless its first line already has them all. If instead the first ntax
+// lines all have the same number of characters after their name, they are
+// the named block of an interleaved file. Characters are counted, not
+// copied.
+bool is_sequential(std::string_view buffer, size_t pos, size_t ntax,
+                   size_t nchar) {
+    std::string_view line;
+    if(!next_line(buffer, pos, line)) {
+        return true;
+    }
+    const size_t width = count_bases(split_name(line).second);
+    if(width >= nchar) {
+        return true;
+    }
+    size_t count{width};
+    size_t block{1};  // lines of the first ntax with width characters
+    for(size_t p = pos; count < nchar && next_line(buffer, p, line);) {
+        count += count_bases(line);
+    }
+    for(size_t p = pos; block < ntax && next_line(buffer, p, line);
+        ++block) {
+        if(count_bases(split_name(line).second) != width) {
+            break;
+        }
+    }
+    return count == nchar && (ntax == 1 || block < ntax);
+}
+}  // namespace
+
+/**
+ * @brief Parse a sequential or interleaved PHYLIP alignment.
+ *
+ * @details The "ntaxa nchar" header sizes every sequence up front. The
+ * layout is decided from the first lines (`is_sequential`), then the body
+ * is read once: sequential taxa continue until they have nchar characters;
+ * interleaved files are one block of named lines followed by unnamed lines
+ * in taxon order. Blank lines are ignored and whitespace inside sequences
+ * is removed.
+ *
+ * @throws std::invalid_argument if the header is malformed, taxa are
+ * missing or a sequence does not have nchar characters.
+ */
+void parse_phylip(std::string_view buffer, sasi::data_t& phylip) {
+    const std::string file = phylip.path.string();
+    size_t pos{0};
+    std::string_view line;
+    if(!next_line(buffer, pos, line)) {
+        return;
+    }
+    size_t ntax{0}, nchar{0}, col{0};
+    if(!read_size(line, col, ntax) || !read_size(line, col, nchar) ||
+       ntax == 0) {
+        throw std::invalid_argument("Malformed PHYLIP header in " + file +
+                                    ".");
+    }
+    std::vector<std::string> names(ntax), seqs(ntax);
+    for(auto& seq : seqs) {
+        seq.reserve(nchar);
+    }
+    auto first_line = [&](size_t i) {
+        if(!next_line(buffer, pos, line)) {
+            throw std::invalid_argument("PHYLIP file " + file +
+                                        " has fewer than " +
+                                        std::to_string(ntax) + " taxa.");
+        }
+        auto [name, rest] = split_name(line);
+        names[i] = name;
+        append_bases(seqs[i], rest);
+    };
+
+    if(is_sequential(buffer, pos, ntax, nchar)) {
+        for(size_t i = 0; i < ntax; ++i) {
+            first_line(i);
+            while(seqs[i].size() < nchar && next_line(buffer, pos, line)) {
+                append_bases(seqs[i], line);
+            }
+        }
+        if(next_line(buffer, pos, line)) {
+            throw std::invalid_argument("PHYLIP file " + file +
+                                        " has more than " +
+                                        std::to_string(ntax) + " taxa.");
+        }
+    } else {
+        for(size_t i = 0; i < ntax; ++i) {
+            first_line(i);
+        }
+        for(size_t i = 0; next_line(buffer, pos, line); i = (i + 1) % ntax) {
+            append_bases(seqs[i], line);
+        }
+    }
+    for(size_t i = 0; i < ntax; ++i) {
+        if(seqs[i].size() != nchar) {
+            throw std::invalid_argument(
+                "Sequence " + names[i] + " of " + file + " has " +
+                std::to_string(seqs[i].size()) + " characters, expected " +
+                std::to_string(nchar) + ".");
+        }
+    }
+
+    std::move(names.begin(), names.end(), std::back_inserter(phylip.names));
+    std::move(seqs.begin(), seqs.end(), std::back_inserter(phylip.seqs));
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("phylip") {
+    std::vector<std::string> names{"alpha", "beta", "gamma"};
+    std::vector<std::string> seqs{"ACGT-ACGTA", "AC-TTACGTT", "GGGTTACGTA"};
+    auto parse = [](std::string_view text) {
+        sasi::data_t data("test.phy");
+        parse_phylip(text, data);
+        return data;
+    };
+    SUBCASE("extensions") {
+        CHECK(is_phylip(".phy"));
+        CHECK(is_phylip(".PHYLIP"));
+        CHECK_FALSE(is_phylip(".fasta"));
+        CHECK_FALSE(is_phylip(""));
+    }
+    SUBCASE("sequential") {
+        auto data = parse(
+            " 3 10\nalpha ACGT-ACGTA\nbeta  AC-TT\nACGTT\n\ngamma GGGTT ACG\n"
+            "TA\n");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+    }
+    SUBCASE("interleaved") {
+        auto data = parse(
+            "3 10\r\nalpha ACGT-\r\nbeta  AC-TT\r\ngamma GGGTT\r\n\r\n"
+            "ACGTA\r\nACGTT\r\nACG TA\r\n");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+    }
+    SUBCASE("sequential, first taxon wrapped") {
+        auto data = parse("2 8\na ACGT\nAC-T\nb ACGT\nTT TT\n");
+        CHECK(data.names == std::vector<std::string>{"a", "b"});
+        CHECK(data.seqs == std::vector<std::string>{"ACGTAC-T", "ACGTTTTT"});
+    }
+    SUBCASE("interleaved, several blocks") {
+        auto data = parse(
+            "3 10\nalpha ACG\nbeta  AC-\ngamma GGG\nT-AC\nTTAC\nTTAC\n"
+            "GTA\nGTT\nGTA\n");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+    }
+    SUBCASE("strict names") {
+        auto data = parse("2 4\nseq1234567ACGT\nSeq2      AC-T\n");
+        CHECK(data.names == std::vector<std::string>{"seq1234567", "Seq2"});
+        CHECK(data.seqs == std::vector<std::string>{"ACGT", "AC-T"});
+    }
+    SUBCASE("unique strict names") {
+        std::vector<std::string> expected{"a", "seq_long_n", "seq_long_1",
+                                          "seq_long_2", "a_1"};
+        CHECK(strict_names({"a", "seq_long_name_1", "seq_long_name_2",
+                            "seq_long_nX", "a"}) == expected);
+    }
+    SUBCASE("errors") {
+        CHECK(parse("").names.empty());
+        CHECK_THROWS_AS(parse(">a\nACGT\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("0 4\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("3 4\na ACGT\nb ACGT\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("2 4\na ACGT\nb ACG\n"), std::invalid_argument);
+        CHECK_THROWS_AS(parse("1 4\na ACGT\nb ACGT\n"),
+                        std::invalid_argument);
+        CHECK_THROWS_AS(parse("2 6\na ACG\nb ACG\nTTT\n"),
+                        std::invalid_argument);
+    }
+    SUBCASE("read_fasta dispatch") {
+        std::ofstream out;
+        out.open("test-phylip.txt");
+        REQUIRE(out);
+        out << "3 10\nalpha ACGT-\nbeta  AC-TT\ngamma GGGTT\n"
+               "ACGTA\nACGTT\nACGTA\n";
+        out.close();
+        auto data = sasi::fasta::read_fasta("phy:test-phylip.txt");
+        CHECK(data.names == names);
+        CHECK(data.seqs == seqs);
+        CHECK(data.records == 3);
+        REQUIRE(std::filesystem::remove("test-phylip.txt"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::phylip
@@ -0,0 +1,433 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sasi/profile.hpp>
+#include <sstream>
+#include <stdexcept>
+
+namespace sasi::profile {
+
+namespace {
+std::atomic<bool> g_enabled{false};
+
+struct registry_t {
+    std::mutex mutex;
+    std::map<std::string, stage_t, std::less<>> stages;
+    std::map<std::string, file_t, std::less<>> files;
+};
+
+registry_t& registry() {
+    static registry_t reg;
+    return reg;
+}
+
+thread_local scope* t_current{nullptr};
+
+// a - b - c clamped at zero, used to turn inclusive counts into self counts
+std::uint64_t self_count(std::uint64_t a, std::uint64_t b, std::uint64_t c) {
+    std::uint64_t d = a > b ? a - b : 0;
+    return d > c ? d - c : 0;
+}
+
+double ipc(const sasi::perf::counters_t& hw) {
+    if(hw.cycles == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(hw.instructions) /
+           static_cast<double>(hw.cycles);
+}
+
+double seconds(std::uint64_t ns) { return static_cast<double>(ns) / 1e9; }
+
+double mb_per_s(size_t bytes, std::uint64_t ns) {
+    if(ns == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(bytes) / 1e6 / seconds(ns);
+}
+
+// json string escaping for file names
+std::string quote(std::string_view str) {
+    std::string ret{"\""};
+    for(char c : str) {
+        if(c == '"' || c == '\\') {
+            ret += '\\';
+            ret += c;
+        } else if(static_cast<unsigned char>(c) < 0x20) {
+            std::ostringstream hex;
+            hex << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << static_cast<int>(c);
+            ret += hex.str();
+        } else {
+            ret += c;
+        }
+    }
+    ret += '"';
+    return ret;
+}
+
+// slowest n files first
+std::vector<file_t> slowest(size_t top) {
+    std::vector<file_t> ret = files();
+    std::sort(ret.begin(), ret.end(), [](const auto& a, const auto& b) {
+        return a.ns > b.ns;
+    });
+    if(ret.size() > top) {
+        ret.resize(top);
+    }
+    return ret;
+}
+}  // namespace
+
+void enable(bool on) { g_enabled.store(on, std::memory_order_relaxed); }
+
+bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void reset() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.stages.clear();
+    reg.files.clear();
+}
+
+std::vector<stage_t> stages() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::vector<stage_t> ret;
+    ret.reserve(reg.stages.size());
+    for(const auto& [name, stage] : reg.stages) {
+        ret.push_back(stage);
+    }
+    return ret;
+}
+
+std::vector<file_t> files() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::vector<file_t> ret;
+    ret.reserve(reg.files.size());
+    for(const auto& [name, file] : reg.files) {
+        ret.push_back(file);
+    }
+    return ret;
+}
+
+scope::scope(std::string_view stage, std::string_view file) {
+    if(!enabled()) {
+        return;
+    }
+    active_ = true;
+    stage_ = stage;
+    file_ = file;
+    parent_ = t_current;
+    t_current = this;
+    if(sasi::memory::enabled()) {
+        track_memory_ = true;
+        memory_start_ = sasi::memory::thread_counters();
+        saved_peak_ = sasi::memory::reset_thread_peak();
+    }
+    track_hw_ = sasi::perf::read(hw_start_);
+    start_ = std::chrono::steady_clock::now();
+}
+
+scope::~scope() {
+    if(!active_) {
+        return;
+    }
+    auto elapsed = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_)
+            .count());
+    sasi::perf::counters_t hw_total;
+    sasi::perf::counters_t hw_self;
+    if(track_hw_ && sasi::perf::read(hw_total)) {
+        hw_total.cycles = self_count(hw_total.cycles, hw_start_.cycles, 0);
+        hw_total.instructions =
+            self_count(hw_total.instructions, hw_start_.instructions, 0);
+        hw_total.cache_misses =
+            self_count(hw_total.cache_misses, hw_start_.cache_misses, 0);
+        hw_total.branch_misses =
+            self_count(hw_total.branch_misses, hw_start_.branch_misses, 0);
+        hw_self.cycles = self_count(hw_total.cycles, 0, child_hw_.cycles);
+        hw_self.instructions =
+            self_count(hw_total.instructions, 0, child_hw_.instructions);
+        hw_self.cache_misses =
+            self_count(hw_total.cache_misses, 0, child_hw_.cache_misses);
+        hw_self.branch_misses =
+            self_count(hw_total.branch_misses, 0, child_hw_.branch_misses);
+    }
+    std::uint64_t self = elapsed > child_ns_ ? elapsed - child_ns_ : 0;
+    t_current = parent_;
+
+    std::uint64_t allocs{0};
+    std::uint64_t alloc_bytes{0};
+    std::int64_t peak{0};
+    if(track_memory_) {
+        sasi::memory::counters_t now = sasi::memory::thread_counters();
+        allocs = now.allocs - memory_start_.allocs;
+        alloc_bytes = now.bytes - memory_start_.bytes;
+        peak = now.peak - memory_start_.live;
+        sasi::memory::restore_thread_peak(saved_peak_);
+    }
+    if(parent_ != nullptr) {
+        parent_->child_ns_ += elapsed;
+        parent_->child_allocs_ += allocs;
+        parent_->child_alloc_bytes_ += alloc_bytes;
+        parent_->child_hw_.cycles += hw_total.cycles;
+        parent_->child_hw_.instructions += hw_total.instructions;
+        parent_->child_hw_.cache_misses += hw_total.cache_misses;
+        parent_->child_hw_.branch_misses += hw_total.branch_misses;
+    }
+    allocs -= std::min(allocs, child_allocs_);
+    alloc_bytes -= std::min(alloc_bytes, child_alloc_bytes_);
+
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto it = reg.stages.find(stage_);
+    if(it == reg.stages.end()) {
+        it = reg.stages.emplace(std::string{stage_}, stage_t{}).first;
+        it->second.name = stage_;
+    }
+    stage_t& stage = it->second;
+    stage.calls++;
+    stage.total_ns += elapsed;
+    stage.self_ns += self;
+    stage.bytes += bytes_;
+    stage.records += records_;
+    stage.allocs += allocs;
+    stage.alloc_bytes += alloc_bytes;
+    stage.peak_bytes = std::max(stage.peak_bytes, peak);
+    stage.hw.cycles += hw_self.cycles;
+    stage.hw.instructions += hw_self.instructions;
+    stage.hw.cache_misses += hw_self.cache_misses;
+    stage.hw.branch_misses += hw_self.branch_misses;
+
+    if(!file_.empty()) {
+        auto fit = reg.files.find(file_);
+        if(fit == reg.files.end()) {
+            fit = reg.files.emplace(std::string{file_}, file_t{}).first;
+            fit->second.name = file_;
+        }
+        // each stage touching a file reports the same bytes and records
+        fit->second.ns += self;
+        fit->second.bytes = std::max(fit->second.bytes, bytes_);
+        fit->second.records = std::max(fit->second.records, records_);
+        fit->second.allocs += allocs;
+        fit->second.alloc_bytes += alloc_bytes;
+        fit->second.peak_bytes = std::max(fit->second.peak_bytes, peak);
+    }
+}
+
+/**
+ * @brief Write stage and slowest file tables as CSV.
+ *
+ * @details Throughput is computed over self time, so a kernel's MB/s does
+ * not include the time spent parsing its input.
+ */
+void report(std::ostream& out, size_t top) {
+    bool mem = sasi::memory::enabled();
+    bool hw = sasi::perf::enabled();
+    out << "stage,calls,total_s,self_s,bytes,records,MB/s"
+        << (mem ? ",allocs,alloc_bytes,peak_bytes" : "")
+        << (hw ? ",cycles,instructions,IPC,cache_misses,branch_misses" : "")
+        << std::endl;
+    for(const auto& stage : stages()) {
+        out << stage.name << "," << stage.calls << ","
+            << seconds(stage.total_ns) << "," << seconds(stage.self_ns) << ","
+            << stage.bytes << "," << stage.records << ","
+            << mb_per_s(stage.bytes, stage.self_ns);
+        if(mem) {
+            out << "," << stage.allocs << "," << stage.alloc_bytes << ","
+                << stage.peak_bytes;
+        }
+        if(hw) {
+            out << "," << stage.hw.cycles << "," << stage.hw.instructions
+                << "," << ipc(stage.hw) << "," << stage.hw.cache_misses << ","
+                << stage.hw.branch_misses;
+        }
+        out << std::endl;
+    }
+    out << "file,seconds,bytes,records,MB/s"
+        << (mem ? ",allocs,alloc_bytes,peak_bytes" : "") << std::endl;
+    for(const auto& file : slowest(top)) {
+        out << file.name << "," << seconds(file.ns) << "," << file.bytes << ","
+            << file.records << "," << mb_per_s(file.bytes, file.ns);
+        if(mem) {
+            out << "," << file.allocs << "," << file.alloc_bytes << ","
+                << file.peak_bytes;
+        }
+        out << std::endl;
+    }
+    if(mem) {
+        out << "heap_peak_bytes,max_rss_bytes" << std::endl
+            << sasi::memory::heap_peak() << "," << sasi::memory::max_rss()
+            << std::endl;
+    }
+}
+
+/**
+ * @brief Write stage and slowest file tables as a JSON object.
+ */
+void report_json(std::ostream& out, size_t top) {
+    out << "{\n  \"stages\": [";
+    std::string_view sep{"\n"};
+    for(const auto& stage : stages()) {
+        out << sep << "    {\"stage\": " << quote(stage.name)
+            << ", \"calls\": " << stage.calls
+            << ", \"total_s\": " << seconds(stage.total_ns)
+            << ", \"self_s\": " << seconds(stage.self_ns)
+            << ", \"bytes\": " << stage.bytes
+            << ", \"records\": " << stage.records
+            << ", \"mb_per_s\": " << mb_per_s(stage.bytes, stage.self_ns)
+            << ", \"allocs\": " << stage.allocs
+            << ", \"alloc_bytes\": " << stage.alloc_bytes
+            << ", \"peak_bytes\": " << stage.peak_bytes;
+        if(sasi::perf::enabled()) {
+            out << ", \"cycles\": " << stage.hw.cycles
+                << ", \"instructions\": " << stage.hw.instructions
+                << ", \"ipc\": " << ipc(stage.hw)
+                << ", \"cache_misses\": " << stage.hw.cache_misses
+                << ", \"branch_misses\": " << stage.hw.branch_misses;
+        }
+        out << "}";
+        sep = ",\n";
+    }
+    out << "\n  ],\n  \"files_total\": " << files().size()
+        << ",\n  \"slowest_files\": [";
+    sep = "\n";
+    for(const auto& file : slowest(top)) {
+        out << sep << "    {\"file\": " << quote(file.name)
+            << ", \"seconds\": " << seconds(file.ns)
+            << ", \"bytes\": " << file.bytes
+            << ", \"records\": " << file.records
+            << ", \"mb_per_s\": " << mb_per_s(file.bytes, file.ns)
+            << ", \"allocs\": " << file.allocs
+            << ", \"alloc_bytes\": " << file.alloc_bytes
+            << ", \"peak_bytes\": " << file.peak_bytes << "}";
+        sep = ",\n";
+    }
+    out << "\n  ],\n  \"memory_tracked\": "
+        << (sasi::memory::enabled() ? "true" : "false")
+        << ",\n  \"perf_counters\": "
+        << (sasi::perf::enabled() ? "true" : "false")
+        << ",\n  \"heap_peak_bytes\": " << sasi::memory::heap_peak()
+        << ",\n  \"max_rss_bytes\": " << sasi::memory::max_rss() << "\n}"
+        << std::endl;
+}
+
+/**
+ * @brief Write profile report to stderr (empty or "-") or to a JSON file.
+ */
+void write_report(const std::string& out_file, size_t top) {
+    if(out_file.empty() || out_file == "-") {
+        report(std::cerr, top);
+        return;
+    }
+    std::ofstream out(out_file);
+    if(!out) {
+        throw std::invalid_argument("Opening profile file " + out_file +
+                                    " failed.");
+    }
+    report_json(out, top);
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("profile") {
+    reset();
+    SUBCASE("disabled") {
+        enable(false);
+        {
+            scope s{"parse", "a.fa"};
+            s.add(10, 1);
+        }
+        CHECK(stages().empty());
+        CHECK(files().empty());
+    }
+    SUBCASE("nested stages") {
+        enable(true);
+        {
+            scope kernel{"gap::frequency", "a.fa"};
+            {
+                scope parse{"parse", "a.fa"};
+                parse.add(100, 2);
+            }
+            kernel.add(80, 2);
+        }
+        {
+            scope parse{"parse", "b.fa"};
+            parse.add(50, 1);
+        }
+        enable(false);
+
+        auto st = stages();
+        REQUIRE(st.size() == 2);
+        CHECK(st[0].name == "gap::frequency");
+        CHECK(st[0].calls == 1);
+        CHECK(st[0].bytes == 80);
+        CHECK(st[0].self_ns <= st[0].total_ns);
+        CHECK(st[1].name == "parse");
+        CHECK(st[1].calls == 2);
+        CHECK(st[1].bytes == 150);
+        CHECK(st[1].records == 3);
+
+        auto fl = files();
+        REQUIRE(fl.size() == 2);
+        CHECK(fl[0].name == "a.fa");
+        CHECK(fl[0].bytes == 100);
+        CHECK(fl[0].records == 2);
+
+        std::ostringstream csv;
+        report(csv, 1);
+        std::string text = csv.str();
+        CHECK(text.find("stage,calls,total_s") == 0);
+        CHECK(text.find("parse,2,") != std::string::npos);
+        // only the slowest file is listed
+        size_t listed = (text.find("\na.fa,") != std::string::npos) +
+                        (text.find("\nb.fa,") != std::string::npos);
+        CHECK(listed == 1);
+
+        std::ostringstream json;
+        report_json(json, 10);
+        CHECK(json.str().find("\"files_total\": 2") != std::string::npos);
+        CHECK(json.str().find("\"stage\": \"parse\"") != std::string::npos);
+    }
+    SUBCASE("memory") {
+        enable(true);
+        sasi::memory::enable(true);
+        {
+            scope kernel{"kernel", "a.fa"};
+            {
+                scope parse{"parse", "a.fa"};
+                std::vector<char> buffer(8192);
+                buffer[0] = 'A';
+            }
+            std::string kept(1024, 'A');
+            kernel.add(kept.size());
+        }
+        sasi::memory::enable(false);
+        enable(false);
+        if(sasi::memory::available()) {
+            auto st = stages();
+            REQUIRE(st.size() == 2);
+            CHECK(st[0].name == "kernel");
+            CHECK(st[0].allocs >= 1);
+            CHECK(st[0].peak_bytes >= 8192);  // nested peak is included
+            CHECK(st[1].allocs == 1);
+            CHECK(st[1].alloc_bytes >= 8192);
+            CHECK(st[1].peak_bytes >= 8192);
+            CHECK(files()[0].peak_bytes >= 8192);
+        }
+    }
+    reset();
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::profile
@@ -0,0 +1,331 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sasi/sample.hpp>
+#include <sstream>
+
+namespace sasi::sample {
+
+/**
+ * @brief Whether records are sampled instead of read in full.
+ */
+bool active(const sasi::args_t& args) {
+    return args.sample_records > 0 || args.sample_fraction < 1.0;
+}
+
+/**
+ * @brief Random seed of one input file, from `args.seed` and its path.
+ *
+ * @details FNV-1a of the path, so the sample of a file does not depend on
+ * the order of the inputs or on the platform.
+ */
+std::uint64_t seed(const sasi::args_t& args, std::string_view path) {
+    std::uint64_t hash{0xcbf29ce484222325ULL};
+    for(char c : path) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ^ args.seed;
+}
+
+/**
+ * @brief Keep a random subset of the records of data, in input order.
+ *
+ * @details `args.sample_records` keeps exactly that many records per file
+ * (selection sampling); otherwise each record is kept with probability
+ * `args.sample_fraction` (Bernoulli sampling). `data.records` is set to the
+ * number of records before sampling.
+ */
+void records(sasi::data_t& data, const sasi::args_t& args) {
+    size_t n = data.seqs.size();
+    data.records = n;
+    if(!active(args)) {
+        return;
+    }
+    if(args.sample_records == 0 &&
+       !(args.sample_fraction > 0.0 && args.sample_fraction <= 1.0)) {
+        throw std::invalid_argument(
+            "Sample fraction must be greater than 0 and at most 1.");
+    }
+    std::mt19937_64 gen(seed(args, data.path.string()));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    size_t kept{0};
+    size_t wanted = std::min(args.sample_records, n);
+    for(size_t i = 0; i < n; ++i) {
+        bool keep = args.sample_records > 0
+                        ? uniform(gen) * static_cast<double>(n - i) <
+                              static_cast<double>(wanted - kept)
+                        : uniform(gen) < args.sample_fraction;
+        if(keep) {
+            if(kept != i) {
+                data.move_record(i, kept);
+            }
+            kept++;
+        }
+    }
+    data.truncate(kept);
+}
+
+/**
+ * @brief Estimate a total over all records from a sample of them.
+ *
+ * @details Expansion estimator N * mean, with the variance of simple random
+ * sampling without replacement, N^2 (1 - n/N) s^2 / n, and a normal
+ * confidence interval clamped at 0.
+ *
+ * @param sum sum of the per-record values of the sample.
+ * @param sum_sq sum of their squares.
+ */
+estimate_t total(double sum, double sum_sq, size_t sampled, size_t records,
+                 double z) {
+    return total(std::vector<stratum_t>{{sum, sum_sq, sampled, records}}, z);
+}
+
+namespace {
+// add the expansion estimate of a stratum to value and var
+void expand(const stratum_t& stratum, double& value, double& var) {
+    if(stratum.sampled == 0) {
+        return;
+    }
+    auto n = static_cast<double>(stratum.sampled);
+    auto big_n = static_cast<double>(stratum.records);
+    double mean = stratum.sum / n;
+    double s2 = stratum.sampled > 1
+                    ? (stratum.sum_sq - n * mean * mean) / (n - 1)
+                    : 0.0;
+    value += big_n * mean;
+    var += big_n * big_n * std::max(0.0, (1.0 - n / big_n) * s2 / n);
+}
+
+// set the confidence interval of est from its variance
+estimate_t interval(estimate_t est, double var, bool unknown, double z) {
+    if(unknown) {
+        est.low = est.high = std::numeric_limits<double>::quiet_NaN();
+        return est;
+    }
+    double se = std::sqrt(var);
+    est.low = std::max(0.0, est.value - z * se);
+    est.high = est.value + z * se;
+    return est;
+}
+}  // namespace
+
+/**
+ * @brief Estimate a total over all records from a sample of each file.
+ *
+ * @details Records are sampled file by file, so every file is a stratum:
+ * the total is the sum of the per-file expansion estimates N_f * mean_f and
+ * its variance the sum of their variances. A file with fewer than two
+ * sampled records out of more has no variance estimate (and without any
+ * sampled record no estimate of its own total), so the interval is then
+ * unknown: both bounds are NaN.
+ */
+estimate_t total(const std::vector<stratum_t>& strata, double z) {
+    estimate_t est;
+    double var{0};
+    bool unknown{false};
+    for(const auto& stratum : strata) {
+        est.sampled += stratum.sampled;
+        est.records += stratum.records;
+        unknown |= stratum.sampled < 2 && stratum.records > stratum.sampled;
+        expand(stratum, est.value, var);
+    }
+    return interval(est, var, unknown, z);
+}
+
+/**
+ * @brief Estimate a total over all records from sparse per-file sums.
+ *
+ * @details As `total` of every file as a stratum, where files has the
+ * sampled and total records of each file and sums the sums of only the
+ * files with a nonzero value: the others add nothing but their records.
+ */
+estimate_t total(const std::vector<stratum_t>& files,
+                 const std::map<size_t, sums_t>& sums, double z) {
+    estimate_t est;
+    double var{0};
+    bool unknown{false};
+    for(const auto& file : files) {
+        est.sampled += file.sampled;
+        est.records += file.records;
+        unknown |= file.sampled < 2 && file.records > file.sampled;
+    }
+    for(const auto& [f, cell] : sums) {
+        stratum_t stratum = files[f];
+        stratum.sum = cell.sum;
+        stratum.sum_sq = cell.sum_sq;
+        expand(stratum, est.value, var);
+    }
+    return interval(est, var, unknown, z);
+}
+
+/**
+ * @brief Write a table of estimates as CSV.
+ *
+ * @details Each row holds its labels, the estimate and the bounds of its
+ * 95% confidence interval with two decimals ("nan" if unknown, see
+ * `total`), the sampled records and the records before sampling.
+ */
+void write(const table_t& table, std::ostream& out) {
+    sasi::profile::scope prof{"output::sample::estimates"};
+    out << table.labels << ",estimate,ci_low,ci_high,sampled,records"
+        << std::endl;
+    // fixed notation without changing the format state of out
+    std::ostringstream values;
+    values << std::fixed << std::setprecision(2);
+    for(const auto& [label, est] : table.rows) {
+        values.str("");
+        values << est.value << ',' << est.low << ',' << est.high;
+        out << label << ',' << values.str() << ',' << est.sampled << ','
+            << est.records << '\n';
+    }
+    out.flush();
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sample") {
+    sasi::data_t data("test.fa");
+    for(size_t i = 0; i < 1000; ++i) {
+        data.names.push_back(std::to_string(i));
+        data.seqs.emplace_back(i % 10, 'A');
+    }
+    sasi::args_t args;
+    SUBCASE("inactive") {
+        records(data, args);
+        CHECK(data.seqs.size() == 1000);
+        CHECK(data.records == 1000);
+    }
+    SUBCASE("fixed number of records") {
+        args.sample_records = 100;
+        sasi::data_t copy = data;
+        records(data, args);
+        CHECK(data.seqs.size() == 100);
+        CHECK(data.records == 1000);
+        CHECK(std::is_sorted(data.names.begin(), data.names.end(),
+                             [](const auto& a, const auto& b) {
+                                 return std::stoul(a) < std::stoul(b);
+                             }));
+        for(size_t k = 0; k < data.seqs.size(); ++k) {
+            CHECK(data.id(k) == std::stoul(data.names[k]));
+        }
+        // same seed, same sample
+        records(copy, args);
+        CHECK(copy.names == data.names);
+        args.sample_records = 5000;
+        records(copy, args);
+        CHECK(copy.seqs.size() == 100);
+    }
+    SUBCASE("fraction") {
+        args.sample_fraction = 0.2;
+        records(data, args);
+        CHECK(data.seqs.size() > 120);
+        CHECK(data.seqs.size() < 280);
+        args.sample_fraction = 0.0;
+        CHECK_THROWS_AS(records(data, args), std::invalid_argument);
+    }
+    SUBCASE("estimates") {
+        // full sample: exact, no interval
+        estimate_t est = total(45.0, 285.0, 10, 10);
+        CHECK(est.value == doctest::Approx(45.0));
+        CHECK(est.low == doctest::Approx(45.0));
+        CHECK(est.high == doctest::Approx(45.0));
+        // values 0..9 sampled from 100 records
+        est = total(45.0, 285.0, 10, 100);
+        CHECK(est.value == doctest::Approx(450.0));
+        CHECK(est.low < 450.0);
+        CHECK(est.high > 450.0);
+        CHECK(est.high - est.value ==
+              doctest::Approx(Z_95 * 100 * std::sqrt(0.9 * 55.0 / 6 / 10)));
+        CHECK(total(0, 0, 0, 10).value == 0.0);
+        // one sampled record of two: no variance estimate
+        est = total(4.0, 16.0, 1, 2);
+        CHECK(est.value == doctest::Approx(8.0));
+        CHECK(std::isnan(est.low));
+        CHECK(std::isnan(est.high));
+        est = total(4.0, 16.0, 1, 1);
+        CHECK(est.low == doctest::Approx(4.0));
+        CHECK(std::isnan(total(0, 0, 0, 10).high));
+        CHECK(total(0, 0, 0, 0).high == 0.0);
+        // strata: each file expanded by its own size
+        std::vector<stratum_t> strata{{10.0, 10.0, 10, 1000},
+                                      {0.0, 0.0, 10, 10}};
+        est = total(strata);
+        CHECK(est.value == doctest::Approx(1000.0));
+        CHECK(est.low == doctest::Approx(1000.0));
+        CHECK(est.high == doctest::Approx(1000.0));
+        CHECK(est.sampled == 20);
+        CHECK(est.records == 1010);
+        strata.push_back({45.0, 285.0, 10, 100});
+        est = total(strata);
+        CHECK(est.value == doctest::Approx(1450.0));
+        CHECK(est.high - est.value ==
+              doctest::Approx(Z_95 * 100 * std::sqrt(0.9 * 55.0 / 6 / 10)));
+    }
+    SUBCASE("cells") {
+        std::ofstream out;
+        out.open("test-cells-1.fa");
+        REQUIRE(out);
+        out << ">a\nA-A--\n>b\nAA-AA\n>c\nAAAAA\n";
+        out.close();
+        out.open("test-cells-2.fa");
+        REQUIRE(out);
+        out << ">d\n---AA\n";
+        out.close();
+        args.input = {"test-cells-1.fa", "test-cells-2.fa"};
+        // gap lengths counted per record
+        auto gaps = cells<size_t>(
+            args, "test", [](const auto& batch, size_t i, auto&& add) {
+                std::string_view seq = batch.seq(i);
+                for(size_t j = 0; j < seq.size(); ++j) {
+                    if(seq[j] == GAP && (j == 0 || seq[j - 1] != GAP)) {
+                        size_t end = std::min(seq.find_first_not_of(GAP, j),
+                                              seq.size());
+                        add(end - j, 1);
+                    }
+                }
+            });
+        REQUIRE(gaps.files.size() == 2);
+        CHECK(gaps.files[0].sampled == 3);
+        CHECK(gaps.files[0].records == 3);
+        CHECK(gaps.files[1].records == 1);
+        REQUIRE(gaps.cells.size() == 3);
+        // length 1: records a and b of the first file, once each
+        const auto& ones = gaps.cells.at(1);
+        REQUIRE(ones.size() == 1);
+        CHECK(ones.at(0).sum == doctest::Approx(2.0));
+        CHECK(ones.at(0).sum_sq == doctest::Approx(2.0));
+        CHECK(gaps.stratum(1, 1).sum == 0.0);
+        CHECK(gaps.stratum(1, 1).records == 1);
+        CHECK(gaps.total(3).value == doctest::Approx(1.0));
+        CHECK(gaps.total(7).value == 0.0);
+        CHECK(gaps.total(7).sampled == 4);
+        // sparse sums estimate as the full strata
+        std::vector<stratum_t> strata{gaps.stratum(1, 0), gaps.stratum(1, 1)};
+        CHECK(gaps.total(1).value == doctest::Approx(total(strata).value));
+        CHECK(gaps.total(1).high == doctest::Approx(total(strata).high));
+        REQUIRE(std::filesystem::remove("test-cells-1.fa"));
+        REQUIRE(std::filesystem::remove("test-cells-2.fa"));
+    }
+    SUBCASE("write") {
+        table_t table{"statistic", {{"frameshifts", {450, 300.5, 599.5, 10,
+                                                     100}}}};
+        table.rows.push_back({"stops", total(4.0, 16.0, 1, 2)});
+        std::ostringstream out;
+        write(table, out);
+        CHECK(out.str() ==
+              "statistic,estimate,ci_low,ci_high,sampled,records\n"
+              "frameshifts,450.00,300.50,599.50,10,100\n"
+              "stops,8.00,nan,nan,1,2\n");
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::sample
@@ -0,0 +1,280 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <numeric>
+#include <sasi/scheduler.hpp>
+#include <sasi/tar.hpp>
+#include <thread>
+
+namespace sasi::sched {
+
+pool_t::pool_t(size_t threads) {
+    threads = std::max<size_t>(1, threads);
+    queues_.reserve(threads);
+    for(size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<queue_t>());
+    }
+}
+
+void pool_t::push(size_t worker, task_t task) {
+    pending_.fetch_add(1, std::memory_order_acq_rel);
+    queue_t& queue = *queues_[worker % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        epoch_++;
+    }
+    idle_.notify_one();
+}
+
+// own tasks are taken newest first, stolen tasks oldest first
+bool pool_t::pop(size_t worker, task_t& task) {
+    {
+        queue_t& own = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for(size_t i = 1; i < queues_.size(); ++i) {
+        queue_t& victim = *queues_[(worker + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void pool_t::work(size_t worker) {
+    task_t task;
+    while(pending_.load(std::memory_order_acquire) > 0) {
+        size_t seen{0};
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            seen = epoch_;
+        }
+        if(!pop(worker, task)) {
+            // a push after reading epoch_ wakes this worker up again
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            idle_.wait(lock, [this, seen]() {
+                return epoch_ != seen ||
+                       pending_.load(std::memory_order_acquire) == 0;
+            });
+            continue;
+        }
+        // after a failure remaining tasks are drained without running
+        if(!failed_.load(std::memory_order_relaxed)) {
+            try {
+                task(worker);
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                if(!error_) {
+                    error_ = std::current_exception();
+                }
+                failed_.store(true, std::memory_order_relaxed);
+            }
+        }
+        task = nullptr;
+        if(pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            {
+                std::lock_guard<std::mutex> lock(idle_mutex_);
+                epoch_++;
+            }
+            idle_.notify_all();
+        }
+    }
+}
+
+void pool_t::run() {
+    std::vector<std::thread> threads;
+    threads.reserve(queues_.size() - 1);
+    for(size_t worker = 1; worker < queues_.size(); ++worker) {
+        threads.emplace_back(&pool_t::work, this, worker);
+    }
+    work(0);
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    if(error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+/**
+ * @brief Queue one task per input file, largest files first.
+ *
+ * @details A file task reads its file, selects records (`select_records`)
+ * and, if its sequences exceed `split_min` bytes, cuts it into batches of
+ * about `batch_bytes` which are pushed to the worker's own deque for others
+ * to steal. A single input file is parsed with all threads instead. Files
+ * left without records by sampling get one empty batch, so their number of
+ * records before sampling is still seen.
+ */
+void schedule_files(const sasi::args_t& args, pool_t& pool,
+                    std::function<void(size_t, const batch_t&)> fn,
+                    size_t split_min, size_t batch_bytes) {
+    // tasks outlive this call, so they share ownership of fn
+    auto task_fn =
+        std::make_shared<std::function<void(size_t, const batch_t&)>>(
+            std::move(fn));
+
+    std::vector<std::uintmax_t> sizes(args.input.size(), 0);
+    for(size_t i = 0; i < args.input.size(); ++i) {
+        auto in_type = sasi::utils::extract_file_type(args.input[i]);
+        if(sasi::tar::is_tar(in_type.type_ext)) {
+            sizes[i] = sasi::tar::input_size(in_type.path);
+            continue;
+        }
+        std::error_code ec;
+        auto size = std::filesystem::file_size(in_type.path, ec);
+        sizes[i] = ec ? 0 : size;
+    }
+    std::vector<size_t> order(args.input.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(),
+        [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    size_t parse_threads = args.input.size() == 1 ? pool.size() : 1;
+    for(size_t k = 0; k < order.size(); ++k) {
+        size_t file = order[k];
+        pool.push(k, [&args, &pool, task_fn, file, parse_threads, split_min,
+                      batch_bytes](size_t worker) {
+            const auto& fn = *task_fn;
+            sasi::data_t parsed = sasi::fasta::read_fasta(
+                args.input[file], args.ignore_empty, parse_threads,
+                args.min_quality > 0);
+            sasi::fasta::select_records(parsed, args, parse_threads);
+            auto data = std::make_shared<const sasi::data_t>(std::move(parsed));
+            size_t n = data->seqs.size();
+            if(n == 0) {
+                // a file emptied by sampling still reports its records
+                if(data->records > 0) {
+                    fn(worker, batch_t{data, file, 0, 0});
+                }
+                return;
+            }
+            if(data->bases() <= split_min) {
+                fn(worker, batch_t{data, file, 0, n});
+                return;
+            }
+            std::vector<batch_t> batches;
+            size_t first{0}, bytes{0};
+            for(size_t i = 0; i < n; ++i) {
+                bytes += data->seqs[i].size();
+                if(bytes >= batch_bytes || i + 1 == n) {
+                    batches.push_back(batch_t{data, file, first, i + 1});
+                    first = i + 1;
+                    bytes = 0;
+                }
+            }
+            for(size_t b = 1; b < batches.size(); ++b) {
+                pool.push(worker, [task_fn, batch = batches[b]](size_t w) {
+                    (*task_fn)(w, batch);
+                });
+            }
+            fn(worker, batches[0]);
+        });
+    }
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("scheduler") {
+    SUBCASE("nested tasks") {
+        pool_t pool(4);
+        std::atomic<size_t> sum{0};
+        for(size_t i = 0; i < 10; ++i) {
+            pool.push(0, [&pool, &sum](size_t worker) {
+                for(size_t j = 0; j < 10; ++j) {
+                    pool.push(worker, [&sum](size_t /*w*/) { sum += 1; });
+                }
+                sum += 100;
+            });
+        }
+        pool.run();
+        CHECK(sum == 1100);
+    }
+    SUBCASE("exception") {
+        pool_t pool(3);
+        for(size_t i = 0; i < 5; ++i) {
+            pool.push(i, [i](size_t /*w*/) {
+                if(i == 2) {
+                    throw std::runtime_error("task failed");
+                }
+            });
+        }
+        CHECK_THROWS_AS(pool.run(), std::runtime_error);
+    }
+    SUBCASE("idle workers sleep") {
+        using namespace std::chrono_literals;
+        pool_t pool(4);
+        std::atomic<size_t> done{0};
+        pool.push(0, [&pool, &done](size_t worker) {
+            std::this_thread::sleep_for(200ms);
+            for(size_t j = 0; j < 8; ++j) {
+                pool.push(worker, [&done](size_t /*w*/) { done += 1; });
+            }
+        });
+        std::clock_t cpu = std::clock();
+        pool.run();
+        // spinning workers would use about 3 x 200 ms of CPU time
+        CHECK(std::clock() - cpu < CLOCKS_PER_SEC / 10);
+        CHECK(done == 8);
+    }
+    SUBCASE("split files into batches") {
+        std::ofstream out;
+        out.open("test-sched-1.fa");
+        REQUIRE(out);
+        for(size_t i = 0; i < 50; ++i) {
+            out << ">" << i << "\nACGTACGTAC\n";
+        }
+        out.close();
+        out.open("test-sched-2.fa");
+        REQUIRE(out);
+        out << ">a\nAC\n";
+        out.close();
+
+        sasi::args_t args;
+        args.input = {"test-sched-1.fa", "test-sched-2.fa"};
+        pool_t pool(3);
+        std::mutex mutex;
+        std::vector<std::pair<size_t, size_t>> seen;  // file, record
+        size_t batches{0};
+        schedule_files(
+            args, pool,
+            [&](size_t /*worker*/, const batch_t& batch) {
+                std::lock_guard<std::mutex> lock(mutex);
+                batches++;
+                for(size_t i = batch.first; i < batch.last; ++i) {
+                    seen.emplace_back(batch.file, i);
+                }
+            },
+            100, 30);
+        pool.run();
+        std::sort(seen.begin(), seen.end());
+        REQUIRE(seen.size() == 51);
+        CHECK(seen[0] == std::pair<size_t, size_t>{0, 0});
+        CHECK(seen[49] == std::pair<size_t, size_t>{0, 49});
+        CHECK(seen[50] == std::pair<size_t, size_t>{1, 0});
+        CHECK(batches == 18);  // 3 records per batch, plus file 2
+        REQUIRE(std::filesystem::remove("test-sched-1.fa"));
+        REQUIRE(std::filesystem::remove("test-sched-2.fa"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::sched
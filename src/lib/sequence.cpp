@@ -2,7 +2,15 @@
 
 #include <doctest.h>
 
+#include <bitset>
+#include <cmath>
+#include <map>
+#include <random>
+#include <sasi/dedup.hpp>
+#include <sasi/fastq.hpp>
+#include <sasi/mask.hpp>
 #include <sasi/sequence.hpp>
+#include <type_traits>
 
 namespace sasi::seq {
 
@@ -12,27 +20,27 @@ namespace sasi::seq {
  * @return size_t count.
  */
 std::pair<size_t, size_t> frameshift(const sasi::args_t& args) {
-    size_t frm{0};
-    size_t total{0};
-    // for each fasta file in input
-    for(const auto& file : args.input) {
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
-
-        if(data.seqs.size() == 0 && args.ignore_empty) {
-            continue;
-        }
-
-        for(std::string& seq : data.seqs) {
-            if(args.discard_gaps) {
-                seq.erase(std::remove(seq.begin(), seq.end(), '-'), seq.end());
-            }
-            total++;
-            if(seq.length() % 3 != 0) {
-                frm++;
+    using count_t = std::pair<size_t, size_t>;  // frameshifts, total
+    auto accs = sasi::sched::for_each_batch<count_t>(
+        args, [&args](count_t& count, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"seq::frameshift",
+                                      args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                size_t length = args.discard_gaps ? batch.gaps().ungapped(i)
+                                                  : batch.seq(i).length();
+                count.second++;
+                if(length % 3 != 0) {
+                    count.first++;
+                }
             }
-        }
+        });
+
+    std::pair<size_t, size_t> count{0, 0};
+    for(const auto& acc : accs) {
+        count.first += acc.first;
+        count.second += acc.second;
     }
-    std::pair<size_t, size_t> count{frm, total};
     return count;
 }
 
@@ -96,6 +104,25 @@ TEST_CASE("sequence_frameshift") {
 }
 // GCOVR_EXCL_STOP
 
+/**
+ * @brief Count **early** stop codons of one sequence.
+ *
+ * @details The trailing 1 or 2 nucleotides are ignored, and so is the last
+ * codon unless `keep_last`.
+ */
+size_t count_stops(std::string_view seq, bool keep_last) {
+    size_t length = seq.length() - (seq.length() % 3);
+    if(seq.length() % 3 == 0 && !keep_last && length >= 3) {
+        length -= 3;
+    }
+    size_t count{0};
+    for(size_t pos = 0; pos < length; pos += 3) {
+        count += static_cast<size_t>(
+            is_stop(seq[pos], seq[pos + 1], seq[pos + 2]));
+    }
+    return count;
+}
+
 /**
  * @brief Count **early** stop codons.
  *
@@ -103,74 +130,78 @@ TEST_CASE("sequence_frameshift") {
  * by sequence, or total count.
  */
 std::vector<std::string> stop_codons(const sasi::args_t& args) {
-    std::vector stop_codons{"TAA", "TAG", "TGA"};
-
-    std::vector<size_t> counts{0, 0, 0};  // total, file, seq
-    std::vector<std::string> file_counts, seq_counts;
-    file_counts.reserve(args.input.size());
-    seq_counts.reserve(args.input.size());
-    file_counts.emplace_back("filename,stop_codons");
-    seq_counts.emplace_back("filename,seqname,stop_codons");
-
-    // for each fasta file in input
-    for(const auto& file : args.input) {
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
-
-        if(data.seqs.size() == 0 && args.ignore_empty) {
-            continue;
-        }
-
-        // find early stop codons on each sequence
-        for(size_t i = 0; i < data.seqs.size(); ++i) {
-            std::string seq{data.seqs[i]};
+    struct stops_t {
+        size_t total{0};
+        std::vector<size_t> files;  // count per input file
+        // file, record, sequence name and count (sequence detail only)
+        std::vector<std::tuple<size_t, size_t, std::string, size_t>> seqs;
+    };
+    stops_t init;
+    init.files.resize(args.input.size(), 0);
 
-            if(args.discard_gaps) {
-                seq.erase(std::remove(seq.begin(), seq.end(), '-'), seq.end());
+    auto accs = sasi::sched::for_each_batch<stops_t>(
+        args,
+        [&args](stops_t& stops, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"seq::stop_codons",
+                                      args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            std::string degapped;
+            // find early stop codons on each sequence
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                std::string_view seq = batch.seq(i);
+                if(args.discard_gaps) {
+                    batch.gaps().degap(i, seq, degapped);
+                    seq = degapped;
+                }
+                size_t count = count_stops(seq, args.stop_keep_last);
+                stops.total += count;
+                stops.files[batch.file] += count;
+                if(count > 0 && args.stop_inf == info_detail::SEQ) {
+                    stops.seqs.emplace_back(batch.file, i,
+                                            batch.data->names[i], count);
+                }
             }
+        },
+        true, init);
 
-            // remove last codon or nucleotides (1 or 2) if sequence length
-            // not multiple of 3
-            if(seq.length() % 3 == 0 && !args.stop_keep_last) {
-                seq = seq.substr(0, seq.length() - 3);
-            } else {
-                seq = seq.substr(0, seq.length() - (seq.length() % 3));
-            }
+    // merge worker counts
+    stops_t stops{init};
+    for(const auto& acc : accs) {
+        stops.total += acc.total;
+        for(size_t f = 0; f < acc.files.size(); ++f) {
+            stops.files[f] += acc.files[f];
+        }
+        stops.seqs.insert(stops.seqs.end(), acc.seqs.begin(), acc.seqs.end());
+    }
 
-            for(size_t pos = 0; pos < seq.length(); pos += 3) {
-                std::string codon = seq.substr(pos, 3);
-                if(std::find(stop_codons.cbegin(), stop_codons.cend(), codon) !=
-                   stop_codons.cend()) {
-                    counts[0]++;
-                    counts[1]++;
-                    counts[2]++;
-                }  // if found stop codon
-            }      // for position in sequence
-
-            // save sequence counts
-            if(args.stop_inf == info_detail::SEQ && counts[2] > 0) {
-                seq_counts.emplace_back(file + "," + data.names[i] + "," +
-                                        std::to_string(counts[2]));
-                counts[2] = 0;
+    if(args.stop_inf == info_detail::FILE) {
+        std::vector<std::string> file_counts{"filename,stop_codons"};
+        for(size_t f = 0; f < args.input.size(); ++f) {
+            if(stops.files[f] > 0) {
+                file_counts.emplace_back(args.input[f] + "," +
+                                         std::to_string(stops.files[f]));
             }
-        }  // for each sequence
-        if(args.stop_inf == info_detail::FILE && counts[1] > 0) {
-            file_counts.emplace_back(file + "," + std::to_string(counts[1]));
-            counts[1] = 0;
         }
-    }  // for each file
-    if(args.stop_inf == info_detail::FILE) {
         if(file_counts.size() == 1) {
             file_counts.emplace_back("files,0");
         }
         return file_counts;
     }
     if(args.stop_inf == info_detail::SEQ) {
+        // restore input order of files and sequences
+        std::sort(stops.seqs.begin(), stops.seqs.end());
+        std::vector<std::string> seq_counts{"filename,seqname,stop_codons"};
+        seq_counts.reserve(stops.seqs.size() + 1);
+        for(const auto& [file, record, name, count] : stops.seqs) {
+            seq_counts.emplace_back(args.input[file] + "," + name + "," +
+                                    std::to_string(count));
+        }
         if(seq_counts.size() == 1) {
             seq_counts.emplace_back("files,sequences,0");
         }
         return seq_counts;
     }
-    return {"stop_codons\n" + std::to_string(counts[0])};
+    return {"stop_codons\n" + std::to_string(stops.total)};
 }
 
 /// @private
@@ -297,26 +328,66 @@ TEST_CASE("sequence_stop_codons") {
 }
 // GCOVR_EXCL_STOP
 
+/**
+ * @brief Count ambiguous nucleotides of one sequence.
+ */
+size_t count_ambiguous(std::string_view seq) {
+    size_t n_amb{0};
+    for(char c : seq) {
+        n_amb += static_cast<size_t>(
+            BASE_CLASS[static_cast<unsigned char>(c)] == CLASS_AMB);
+    }
+    return n_amb;
+}
+
 /**
  * @brief Count number of ambiguous nucleotides.
  *
  * @return std::size_t count.
  */
 std::size_t ambiguous(const sasi::args_t& args) {
-    size_t n_amb{0};
-    const std::string amb{"ryswkmbdhvnRYSWKMBDHVN"};
-    // for each fasta file in input
-    for(const auto& file : args.input) {
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
-        // for sequence in file
-        for(const std::string& seq : data.seqs) {
-            n_amb += std::count_if(seq.begin(), seq.end(), [amb](auto s) {
-                return std::any_of(amb.begin(), amb.end(),
-                                   [s](auto c) { return s == c; });
-            });
-        }
+    auto accs = sasi::sched::for_each_batch<size_t>(
+        args, [&args](size_t& n_amb, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"seq::ambiguous",
+                                      args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            // for sequence in batch
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                std::string_view seq = batch.seq(i);
+                n_amb += count_ambiguous(seq);
+            }
+        });
+    return std::accumulate(accs.begin(), accs.end(), size_t{0});
+}
+
+/**
+ * @brief Count ambiguous nucleotides and FASTQ bases with Phred quality
+ * below `args.min_quality`.
+ *
+ * @details Both counts come from one pass over each batch. Inputs without
+ * qualities (FASTA and other alignment formats) are rejected when read.
+ *
+ * @return std::pair<size_t, size_t> ambiguous and low quality counts.
+ */
+std::pair<size_t, size_t> ambiguous_quality(const sasi::args_t& args) {
+    using counts_t = std::pair<size_t, size_t>;
+    auto accs = sasi::sched::for_each_batch<counts_t>(
+        args, [&args](counts_t& counts, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"seq::ambiguous_quality",
+                                      args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                counts.first += count_ambiguous(batch.seq(i));
+                counts.second += sasi::fastq::count_below(
+                    batch.qual(i), args.min_quality, args.phred_offset);
+            }
+        });
+    counts_t total{0, 0};
+    for(const auto& counts : accs) {
+        total.first += counts.first;
+        total.second += counts.second;
     }
-    return n_amb;
+    return total;
 }
 
 /// @private
@@ -365,33 +436,111 @@ TEST_CASE("sequence_ambiguous") {
         std::string file2{">1\nbaaandnnhwk\n>2\ncccccacacagt"};
         test({file1, file2}, {"test1.fasta", "test2.fasta"}, 17);
     }
+    SUBCASE("low quality bases") {
+        std::ofstream out;
+        out.open("test-amb.fq");
+        REQUIRE(out);
+        out << "@r1\nACNNT\n+\nII#5!\n@r2\nGGTTA\n+\n55555\n";
+        out.close();
+        out.open("test-amb.fasta");
+        REQUIRE(out);
+        out << ">s\nNNA\n";
+        out.close();
+        sasi::args_t args;
+        args.input = {"test-amb.fq", "test-amb.fasta"};
+        CHECK(ambiguous_quality(args) == std::make_pair(size_t{4}, size_t{0}));
+        // -q needs qualities on every input
+        args.min_quality = 20;
+        CHECK_THROWS_AS(ambiguous_quality(args), std::invalid_argument);
+        args.input = {"test-amb.fq"};
+        CHECK(ambiguous_quality(args) == std::make_pair(size_t{2}, size_t{2}));
+        args.min_quality = 21;
+        args.threads = 2;
+        CHECK(ambiguous_quality(args) == std::make_pair(size_t{2}, size_t{8}));
+
+        // the sampled estimate keeps the low quality column
+        args.sample_records = 2;
+        auto table = estimate(args, verb::AMB);
+        REQUIRE(table.rows.size() == 2);
+        CHECK(table.rows[0].first == "ambiguous_nucleotides");
+        CHECK(table.rows[0].second.value == doctest::Approx(2.0));
+        CHECK(table.rows[1].first == "low_quality_bases");
+        CHECK(table.rows[1].second.value == doctest::Approx(8.0));
+        REQUIRE(std::filesystem::remove("test-amb.fq"));
+        REQUIRE(std::filesystem::remove("test-amb.fasta"));
+    }
 }
 // GCOVR_EXCL_STOP
 
+/**
+ * @brief Count aligned base pairs by type and phase for pairwise alignments.
+ *
+ * @details Each column is one increment of a flat table indexed by
+ * (phase, base1, base2); columns with a gap go to a discarded slot, so the
+ * loop has no branches.
+ *
+ * @return subst_matrix_t pair counts per phase.
+ */
+subst_matrix_t subst_matrix(const sasi::args_t& args) {
+    // 3 phases x 5 x 5 pairs, plus one slot for columns with gaps
+    constexpr size_t N_PAIRS{25};
+    constexpr size_t GAP_SLOT{3 * N_PAIRS};
+    using slots_t = std::vector<size_t>;
+    // files are not split, both sequences are needed together
+    auto accs = sasi::sched::for_each_batch<slots_t>(
+        args,
+        [&args](slots_t& slots, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{"seq::subst", args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            // a file emptied by sampling has no pair to compare
+            if(batch.first == batch.last) {
+                return;
+            }
+            if(batch.data->seqs.size() != 2) {
+                throw std::invalid_argument("Pairwise alignments only.");
+            }
+            const std::string_view seq1 = batch.seq(0);
+            const std::string_view seq2 = batch.seq(1);
+            if(seq1.length() != seq2.length()) {
+                throw std::invalid_argument(
+                    "Pairwise alignments must have equal length sequences.");
+            }
+            size_t phase{0};
+            for(size_t i = 0; i < seq1.length(); ++i) {
+                auto c1 = static_cast<unsigned char>(seq1[i]);
+                auto c2 = static_cast<unsigned char>(seq2[i]);
+                size_t slot = phase + 5U * NUC_INDEX[c1] + NUC_INDEX[c2];
+                bool gap = ((BASE_CLASS[c1] | BASE_CLASS[c2]) & CLASS_GAP) != 0;
+                slots[gap ? GAP_SLOT : slot]++;
+                phase = phase == 2 * N_PAIRS ? 0 : phase + N_PAIRS;
+            }
+        },
+        false, slots_t(GAP_SLOT + 1, 0));
+
+    subst_matrix_t matrix;
+    for(const auto& acc : accs) {
+        for(size_t p = 0; p < 3; ++p) {
+            for(size_t a = 0; a < 5; ++a) {
+                for(size_t b = 0; b < 5; ++b) {
+                    matrix.counts[p][a][b] += acc[p * N_PAIRS + 5 * a + b];
+                }
+            }
+        }
+    }
+    return matrix;
+}
+
 /**
  * @brief Count number of substitutions by phase for pairwise alignments.
  *
  * @return std::size_t count.
  */
 std::vector<std::size_t> subst(const sasi::args_t& args) {
+    subst_matrix_t matrix = subst_matrix(args);
     std::vector<size_t> counts{0, 0, 0};
-    // for each fasta file in input
-    for(const auto& file : args.input) {
-        sasi::data_t data = sasi::fasta::read_fasta(file, args.ignore_empty);
-        if(data.seqs.size() != 2) {
-            throw std::invalid_argument("Pairwise alignments only.");
-        }
-        const std::string_view seq1 = data.seqs[0];
-        const std::string_view seq2 = data.seqs[1];
-        // for sequence in file
-        if(seq1.length() != seq2.length()) {
-            throw std::invalid_argument(
-                "Pairwise alignments must have equal length sequences.");
-        }
-        for(size_t i = 0; i < seq1.length(); ++i) {
-            if(seq1[i] != '-' && seq2[i] != '-') {
-                counts[i % 3]++;
-            }
+    for(size_t p = 0; p < 3; ++p) {
+        for(const auto& row : matrix.counts[p]) {
+            counts[p] += std::accumulate(row.begin(), row.end(), size_t{0});
         }
     }
     return counts;
@@ -442,4 +591,1429 @@ TEST_CASE("subst") {
 }
 // GCOVR_EXCL_STOP
 
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("subst_matrix") {
+    std::ofstream out;
+    out.open("test-matrix.fasta");
+    REQUIRE(out);
+    // phase 0: A/A C/T T/T -/-, phase 1: A/G G/G N/C, phase 2: C/A A/C T/-
+    out << ">1\nAACCGATNT-\n>2\nAGATGCTC--\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-matrix.fasta"};
+    subst_matrix_t matrix = subst_matrix(args);
+    subst_matrix_t expected;
+    expected.counts[0][0][0] = 1;         // A A
+    expected.counts[0][1][3] = 1;         // C T
+    expected.counts[0][3][3] = 1;         // T T
+    expected.counts[1][0][2] = 1;         // A G
+    expected.counts[1][2][2] = 1;         // G G
+    expected.counts[1][NOT_ACGT][1] = 1;  // N C
+    expected.counts[2][1][0] = 1;         // C A
+    expected.counts[2][0][1] = 1;         // A C
+    CHECK(matrix.counts == expected.counts);
+    CHECK(matrix.transitions(0) == 1);
+    CHECK(matrix.transversions(0) == 0);
+    CHECK(matrix.transitions(1) == 1);
+    CHECK(matrix.transversions(1) == 0);
+    CHECK(matrix.transitions(2) == 0);
+    CHECK(matrix.transversions(2) == 2);
+    CHECK(subst(args) == std::vector<size_t>{3, 3, 2});
+    // both records sampled away: nothing to count, no error
+    args.sample_fraction = 1e-9;
+    CHECK(subst(args) == std::vector<size_t>{0, 0, 0});
+    REQUIRE(std::filesystem::remove("test-matrix.fasta"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Fill the prefix sums of gaps, ambiguous nucleotides and G/C.
+ *
+ * @details One pass over the sequence; characters are classified through
+ * `BASE_CLASS` without branches.
+ */
+void prefix_counts_t::build(std::string_view seq) {
+    if(seq.size() >= UINT32_MAX) {
+        throw std::runtime_error("Sequence too long for window counts.");
+    }
+    gaps_.resize(seq.size() + 1);
+    ambiguous_.resize(seq.size() + 1);
+    gc_.resize(seq.size() + 1);
+    std::uint32_t gaps{0}, amb{0}, gc{0};
+    gaps_[0] = ambiguous_[0] = gc_[0] = 0;
+    for(size_t i = 0; i < seq.size(); ++i) {
+        std::uint8_t c = BASE_CLASS[static_cast<unsigned char>(seq[i])];
+        gaps += c & CLASS_GAP;
+        amb += (c & CLASS_AMB) >> 1U;
+        gc += (c & CLASS_GC) >> 2U;
+        gaps_[i + 1] = gaps;
+        ambiguous_[i + 1] = amb;
+        gc_[i + 1] = gc;
+    }
+}
+
+/**
+ * @brief Counts in positions [begin, end) of the sequence.
+ */
+window_counts_t prefix_counts_t::count(size_t begin, size_t end) const {
+    return {gaps_[end] - gaps_[begin], ambiguous_[end] - ambiguous_[begin],
+            gc_[end] - gc_[begin]};
+}
+
+/**
+ * @brief Build window prefix sums for every sequence, in input order.
+ *
+ * @details `fn` is called once per non-empty record, so results can be
+ * written before the next record is read; memory does not depend on the
+ * number of windows.
+ */
+void window(const sasi::args_t& args, const window_fn_t& fn) {
+    if(args.window_size == 0 || args.window_step == 0) {
+        throw std::invalid_argument(
+            "Window size and step must be greater than 0.");
+    }
+    prefix_counts_t sums;
+    for(const auto& file : args.input) {
+        sasi::data_t data = sasi::fasta::read_fasta(file, args);
+        sasi::profile::scope prof{"seq::window", file};
+        prof.add(data.bases(), data.seqs.size());
+        for(size_t i = 0; i < data.seqs.size(); ++i) {
+            if(data.seqs[i].empty()) {
+                continue;
+            }
+            sums.build(data.seqs[i]);
+            fn(file, data.names[i], sums);
+        }
+    }
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_window") {
+    std::ofstream out;
+    out.open("test-window.fa");
+    REQUIRE(out);
+    out << ">1\nAC-GN-NNgcta\n>2\n\n>3\nrA--\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-window.fa"};
+    std::vector<std::string> names;
+    std::vector<window_counts_t> totals;
+    std::vector<window_counts_t> windows;
+    window(args, [&](const std::string& file, const std::string& name,
+                     const prefix_counts_t& sums) {
+        CHECK(file == "test-window.fa");
+        names.push_back(name);
+        totals.push_back(sums.count(0, sums.size()));
+        if(name == "1") {
+            for(size_t start = 0; start < sums.size(); start += 4) {
+                windows.push_back(sums.count(start, start + 4));
+            }
+        }
+    });
+    CHECK(names == std::vector<std::string>{"1", "3"});
+    CHECK(totals ==
+          std::vector<window_counts_t>{{2, 3, 4}, {2, 1, 0}});
+    CHECK(windows ==
+          std::vector<window_counts_t>{{1, 0, 2}, {1, 3, 0}, {0, 0, 2}});
+
+    args.window_step = 0;
+    CHECK_THROWS_AS(window(args, [](const std::string& /*file*/,
+                                    const std::string& /*name*/,
+                                    const prefix_counts_t& /*sums*/) {}),
+                    std::invalid_argument);
+    REQUIRE(std::filesystem::remove("test-window.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Nucleotide composition of one sequence.
+ *
+ * @details Byte histogram over four interleaved tables, so consecutive
+ * equal characters do not wait on the same counter, folded into classes at
+ * the end; ambiguity codes follow `BASE_CLASS`.
+ */
+composition_t count_bases(std::string_view seq) {
+    std::array<std::array<size_t, 256>, 4> hist{};
+    const auto* bytes = reinterpret_cast<const unsigned char*>(seq.data());
+    size_t n = seq.size();
+    size_t i{0};
+    for(; i + 4 <= n; i += 4) {
+        hist[0][bytes[i]]++;
+        hist[1][bytes[i + 1]]++;
+        hist[2][bytes[i + 2]]++;
+        hist[3][bytes[i + 3]]++;
+    }
+    for(; i < n; ++i) {
+        hist[0][bytes[i]]++;
+    }
+
+    composition_t comp;
+    for(size_t b = 0; b < 256; ++b) {
+        size_t count = hist[0][b] + hist[1][b] + hist[2][b] + hist[3][b];
+        if(count == 0) {
+            continue;
+        }
+        switch(static_cast<char>(b)) {
+        case 'A':
+        case 'a':
+            comp.a += count;
+            break;
+        case 'C':
+        case 'c':
+            comp.c += count;
+            break;
+        case 'G':
+        case 'g':
+            comp.g += count;
+            break;
+        case 'T':
+        case 't':
+            comp.t += count;
+            break;
+        default:
+            if(BASE_CLASS[b] == CLASS_GAP) {
+                comp.gaps += count;
+            } else if(BASE_CLASS[b] == CLASS_AMB) {
+                comp.ambiguous += count;
+            } else {
+                comp.other += count;
+            }
+        }
+    }
+    return comp;
+}
+
+namespace {
+/**
+ * @brief Sum per-sequence statistics in total, by file or by sequence.
+ *
+ * @details `count(seq, value)` adds the statistics of one sequence to a
+ * zero-initialized `value`; a `count(seq, qual, value)` also gets the
+ * FASTQ quality of the record (empty if not read). With `degap` gaps are
+ * removed from each sequence first. Rows are labelled "filename" or
+ * "filename,seqname"; the total is a single row with an empty label.
+ */
+template <class T, class F>
+std::vector<std::pair<std::string, T>> by_detail(const sasi::args_t& args,
+                                                 sasi::info_detail detail,
+                                                 std::string_view stage,
+                                                 bool degap, F&& count) {
+    struct acc_t {
+        T total;
+        std::vector<T> files;
+        // file, record, sequence name and value (sequence detail only)
+        std::vector<std::tuple<size_t, size_t, std::string, T>> seqs;
+    };
+    acc_t init;
+    init.files.resize(args.input.size());
+
+    auto accs = sasi::sched::for_each_batch<acc_t>(
+        args,
+        [&args, &count, detail, stage, degap](
+            acc_t& acc, const sasi::sched::batch_t& batch) {
+            sasi::profile::scope prof{stage, args.input[batch.file]};
+            prof.add(batch.bytes(), batch.last - batch.first);
+            std::string degapped;
+            for(size_t i = batch.first; i < batch.last; ++i) {
+                std::string_view seq = batch.seq(i);
+                if(degap) {
+                    batch.gaps().degap(i, seq, degapped);
+                    seq = degapped;
+                }
+                T value{};
+                if constexpr(std::is_invocable_v<F&, std::string_view,
+                                                  std::string_view, T&>) {
+                    count(seq, batch.qual(i), value);
+                } else {
+                    count(seq, value);
+                }
+                acc.total += value;
+                acc.files[batch.file] += value;
+                if(detail == info_detail::SEQ) {
+                    acc.seqs.emplace_back(batch.file, i,
+                                          batch.data->names[i], value);
+                }
+            }
+        },
+        true, init);
+
+    // merge worker values
+    acc_t merged{init};
+    for(const auto& acc : accs) {
+        merged.total += acc.total;
+        for(size_t f = 0; f < acc.files.size(); ++f) {
+            merged.files[f] += acc.files[f];
+        }
+        merged.seqs.insert(merged.seqs.end(), acc.seqs.begin(),
+                           acc.seqs.end());
+    }
+
+    std::vector<std::pair<std::string, T>> rows;
+    if(detail == info_detail::FILE) {
+        for(size_t f = 0; f < args.input.size(); ++f) {
+            rows.emplace_back(args.input[f], merged.files[f]);
+        }
+    } else if(detail == info_detail::SEQ) {
+        // restore input order of files and sequences
+        std::sort(merged.seqs.begin(), merged.seqs.end(),
+                  [](const auto& a, const auto& b) {
+                      return std::tie(std::get<0>(a), std::get<1>(a)) <
+                             std::tie(std::get<0>(b), std::get<1>(b));
+                  });
+        rows.reserve(merged.seqs.size());
+        for(const auto& [file, record, name, value] : merged.seqs) {
+            rows.emplace_back(args.input[file] + "," + name, value);
+        }
+    } else {
+        rows.emplace_back("", merged.total);
+    }
+    return rows;
+}
+}  // namespace
+
+/**
+ * @brief Nucleotide composition in total, by file or by sequence.
+ *
+ * @details Gaps are always counted in `gaps`, so `discard_gaps` does not
+ * apply. With `args.min_quality`, FASTQ bases below it are counted in
+ * `low_quality`.
+ *
+ * @return std::vector<std::pair<std::string, composition_t>> one row per
+ * file ("filename") or sequence ("filename,seqname"), or a single row with
+ * an empty label for the total.
+ */
+std::vector<std::pair<std::string, composition_t>> composition(
+    const sasi::args_t& args) {
+    return by_detail<composition_t>(
+        args, args.comp_inf, "seq::composition", false,
+        [&args](std::string_view seq, std::string_view qual,
+                composition_t& comp) {
+            comp = count_bases(seq);
+            comp.low_quality = sasi::fastq::count_below(
+                qual, args.min_quality, args.phred_offset);
+        });
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_composition") {
+    std::ofstream out;
+    out.open("test-comp-1.fa");
+    REQUIRE(out);
+    out << ">1\nACGTacgtNn--\n>2\nGGCCAX*\n";
+    out.close();
+    out.open("test-comp-2.fa");
+    REQUIRE(out);
+    out << ">3\nTTTTrY-\n";
+    out.close();
+
+    // A C G T gaps ambiguous other
+    composition_t seq1{2, 2, 2, 2, 2, 2, 0};
+    composition_t seq2{1, 2, 2, 0, 0, 0, 2};
+    composition_t seq3{0, 0, 0, 4, 1, 2, 0};
+    CHECK(count_bases("ACGTacgtNn--") == seq1);
+    CHECK(count_bases("") == composition_t{});
+    CHECK(count_bases("GGCCAX*").gc_content() == doctest::Approx(0.8));
+
+    sasi::args_t args;
+    args.input = {"test-comp-1.fa", "test-comp-2.fa"};
+    composition_t total{seq1};
+    total += seq2;
+    total += seq3;
+    auto rows = composition(args);
+    REQUIRE(rows.size() == 1);
+    CHECK(rows[0].first.empty());
+    CHECK(rows[0].second == total);
+
+    args.comp_inf = info_detail::FILE;
+    composition_t file1{seq1};
+    file1 += seq2;
+    rows = composition(args);
+    REQUIRE(rows.size() == 2);
+    CHECK(rows[0] == std::make_pair(std::string{"test-comp-1.fa"}, file1));
+    CHECK(rows[1] == std::make_pair(std::string{"test-comp-2.fa"}, seq3));
+
+    args.comp_inf = info_detail::SEQ;
+    args.threads = 2;
+    rows = composition(args);
+    REQUIRE(rows.size() == 3);
+    CHECK(rows[0] == std::make_pair(std::string{"test-comp-1.fa,1"}, seq1));
+    CHECK(rows[1] == std::make_pair(std::string{"test-comp-1.fa,2"}, seq2));
+    CHECK(rows[2] == std::make_pair(std::string{"test-comp-2.fa,3"}, seq3));
+
+    // -g does not apply: gaps stay in the gaps column
+    args.discard_gaps = true;
+    rows = composition(args);
+    REQUIRE(rows.size() == 3);
+    CHECK(rows[0].second == seq1);
+    CHECK(rows[2].second == seq3);
+    args.discard_gaps = false;
+
+    REQUIRE(std::filesystem::remove("test-comp-1.fa"));
+    REQUIRE(std::filesystem::remove("test-comp-2.fa"));
+
+    // A C G T gaps ambiguous other low_quality
+    out.open("test-comp-3.fq");
+    REQUIRE(out);
+    out << "@q\nACGN\n+\n#I#I\n";
+    out.close();
+    args.input = {"test-comp-3.fq"};
+    args.comp_inf = info_detail::TOTAL;
+    args.min_quality = 10;
+    rows = composition(args);
+    REQUIRE(rows.size() == 1);
+    CHECK(rows[0].second == composition_t{1, 1, 1, 0, 0, 1, 0, 2});
+    REQUIRE(std::filesystem::remove("test-comp-3.fq"));
+}
+// GCOVR_EXCL_STOP
+
+namespace {
+// NCBI genetic codes, amino acids in TCAG codon order
+const std::map<size_t, std::string_view> NCBI_CODES{
+    {1, "FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {2, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSS**VVVVAAAADDEEGGGG"},
+    {3, "FFLLSSSSYY**CCWWTTTTPPPPHHQQRRRRIIMMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {4, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {5, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSSSVVVVAAAADDEEGGGG"},
+    {6, "FFLLSSSSYYQQCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {9, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG"},
+    {10, "FFLLSSSSYY**CCCWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {11, "FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {12, "FFLLSSSSYY**CC*WLLLSPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG"},
+    {13, "FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSGGVVVVAAAADDEEGGGG"},
+    {14, "FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG"}};
+}  // namespace
+
+/**
+ * @brief Codon of a packed codon index, e.g. 0 = "AAA", 63 = "TTT".
+ */
+std::string codon_name(size_t index) {
+    constexpr std::string_view bases{"ACGT"};
+    return {bases[(index >> 4U) & 3U], bases[(index >> 2U) & 3U],
+            bases[index & 3U]};
+}
+
+/**
+ * @brief Amino acids of NCBI genetic code `id`, indexed by packed codon.
+ *
+ * @return std::string 64 one-letter amino acids, '*' for stop codons.
+ */
+std::string genetic_code(size_t id) {
+    auto it = NCBI_CODES.find(id);
+    if(it == NCBI_CODES.end()) {
+        throw std::invalid_argument("Unsupported genetic code " +
+                                    std::to_string(id) + ".");
+    }
+    // position of A C G T in TCAG order
+    constexpr std::array<size_t, 4> tcag{2, 1, 3, 0};
+    std::string code(N_CODONS, '*');
+    for(size_t i = 0; i < N_CODONS; ++i) {
+        code[i] = it->second[16 * tcag[(i >> 4U) & 3U] +
+                             4 * tcag[(i >> 2U) & 3U] + tcag[i & 3U]];
+    }
+    return code;
+}
+
+namespace {
+// 3-bit class of each character: A C G T = 0-3, gap = 5, anything else 4
+constexpr std::uint8_t CODON_GAP{5U};
+constexpr std::array<std::uint8_t, 256> make_codon_class() {
+    std::array<std::uint8_t, 256> table{NUC_INDEX};
+    table[static_cast<unsigned char>(GAP)] = CODON_GAP;
+    return table;
+}
+constexpr std::array<std::uint8_t, 256> CODON_CLASS{make_codon_class()};
+
+constexpr std::array<char, 256> make_complement() {
+    std::array<char, 256> table{};
+    for(size_t i = 0; i < table.size(); ++i) {
+        table[i] = static_cast<char>(i);
+    }
+    std::string_view from{"ACGTURYKMBVDHacgturykmbvdh"};
+    std::string_view to{"TGCAAYRMKVBHDtgcaayrmkvbhd"};
+    for(size_t i = 0; i < from.size(); ++i) {
+        table[static_cast<unsigned char>(from[i])] = to[i];
+    }
+    return table;
+}
+constexpr std::array<char, 256> COMPLEMENT{make_complement()};
+}  // namespace
+
+/**
+ * @brief Translation table over packed codon classes.
+ *
+ * @details Entry (c1 << 6) | (c2 << 3) | c3 holds the amino acid of an
+ * ACGT codon, '-' for a gap codon and 'X' for any other mix, so
+ * translation needs no branches.
+ */
+codon_table_t codon_table(const std::string& code) {
+    codon_table_t table{};
+    table.fill('X');
+    for(unsigned c = 0; c < N_CODONS; ++c) {
+        table[((c >> 4U) << 6U) | (((c >> 2U) & 3U) << 3U) | (c & 3U)] =
+            code[c];
+    }
+    table[(CODON_GAP << 6U) | (CODON_GAP << 3U) | CODON_GAP] = GAP;
+    return table;
+}
+
+/**
+ * @brief Translate the complete codons of seq, starting at its first base.
+ */
+std::string translate(std::string_view seq, const codon_table_t& table) {
+    std::string protein(seq.size() / 3, '\0');
+    const auto* bases = reinterpret_cast<const unsigned char*>(seq.data());
+    for(size_t i = 0; i < protein.size(); ++i, bases += 3) {
+        protein[i] = table[(CODON_CLASS[bases[0]] << 6U) |
+                           (CODON_CLASS[bases[1]] << 3U) |
+                           CODON_CLASS[bases[2]]];
+    }
+    return protein;
+}
+
+/**
+ * @brief Reverse complement, keeping case; IUPAC codes are complemented
+ * and other characters (gaps, N) kept.
+ */
+std::string reverse_complement(std::string_view seq) {
+    std::string ret(seq.size(), '\0');
+    for(size_t i = 0; i < seq.size(); ++i) {
+        ret[seq.size() - 1 - i] =
+            COMPLEMENT[static_cast<unsigned char>(seq[i])];
+    }
+    return ret;
+}
+
+/**
+ * @brief Occurrences of every residue in the sequences of data.
+ */
+residue_counts_t count_residues(const sasi::data_t& data) {
+    residue_counts_t counts{};
+    for(const auto& seq : data.seqs) {
+        for(char c : seq) {
+            counts[static_cast<unsigned char>(c)]++;
+        }
+    }
+    return counts;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_translate") {
+    const codon_table_t table = codon_table(genetic_code(1));
+    SUBCASE("codons") {
+        CHECK(translate("ATGTTTTAA", table) == "MF*");
+        CHECK(translate("atgtggTG", table) == "MW");
+        CHECK(translate("AUG---A-GNNN", table) == "M-XX");
+        CHECK(translate("", table).empty());
+        CHECK(translate("TGA", codon_table(genetic_code(2))) == "W");
+    }
+    SUBCASE("reverse complement") {
+        CHECK(reverse_complement("ACGTN-ry") == "ry-NACGT");
+        CHECK(reverse_complement("") == "");
+    }
+    SUBCASE("files") {
+        std::ofstream out;
+        out.open("test-translate.fa");
+        REQUIRE(out);
+        out << ">a\nATG-TT-TTAA\n>b\nCCCAAAT\n";
+        out.close();
+        sasi::args_t args;
+        args.input = {"test-translate.fa"};
+        std::vector<std::string> names, seqs;
+        auto collect = [&](const sasi::data_t& data) {
+            names = data.names;
+            seqs = data.seqs;
+        };
+        translate(args, collect);
+        CHECK(seqs == std::vector<std::string>{"MXX", "PK"});
+        args.discard_gaps = true;
+        args.frame = 2;
+        translate(args, collect);
+        CHECK(seqs == std::vector<std::string>{"CF", "PN"});
+        args.frame = 4;  // reverse complement, first frame
+        translate(args, collect);
+        CHECK(seqs == std::vector<std::string>{"LKH", "IW"});
+        args.six_frames = true;
+        translate(args, collect);
+        REQUIRE(names.size() == 12);
+        CHECK(names[0] == "a_frame=1");
+        CHECK(names[11] == "b_frame=6");
+        CHECK(seqs[3] == "LKH");
+        CHECK(count_residues(sasi::data_t{"", names, seqs})['K'] == 3);
+        REQUIRE(std::filesystem::remove("test-translate.fa"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Add the in-frame codons of a sequence to `counts`.
+ *
+ * @details Codons are packed into 6-bit indices through `NUC_INDEX`;
+ * codons with a gap or any other non-ACGT character go to a discarded
+ * slot instead of branching.
+ */
+void count_codons(std::string_view seq, codon_counts_t& counts) {
+    std::array<size_t, N_CODONS + 1> slots{};
+    size_t length = seq.length() - seq.length() % 3;
+    for(size_t pos = 0; pos < length; pos += 3) {
+        unsigned n1 = NUC_INDEX[static_cast<unsigned char>(seq[pos])];
+        unsigned n2 = NUC_INDEX[static_cast<unsigned char>(seq[pos + 1])];
+        unsigned n3 = NUC_INDEX[static_cast<unsigned char>(seq[pos + 2])];
+        unsigned index = (n1 << 4U) | (n2 << 2U) | n3;
+        slots[((n1 | n2 | n3) & NOT_ACGT) != 0 ? N_CODONS : index]++;
+    }
+    for(size_t i = 0; i < N_CODONS; ++i) {
+        counts.counts[i] += slots[i];
+    }
+}
+
+/**
+ * @brief Relative synonymous codon usage.
+ *
+ * @details Observed count over the mean count of the codons coding for the
+ * same amino acid (or stop); 0 when none of them is used.
+ */
+std::array<double, N_CODONS> rscu(const codon_counts_t& counts,
+                                  const std::string& code) {
+    std::array<size_t, 256> total{}, synonyms{};
+    for(size_t i = 0; i < N_CODONS; ++i) {
+        auto aa = static_cast<unsigned char>(code[i]);
+        total[aa] += counts.counts[i];
+        synonyms[aa]++;
+    }
+    std::array<double, N_CODONS> ret{};
+    for(size_t i = 0; i < N_CODONS; ++i) {
+        auto aa = static_cast<unsigned char>(code[i]);
+        if(total[aa] > 0) {
+            ret[i] = static_cast<double>(counts.counts[i] * synonyms[aa]) /
+                     static_cast<double>(total[aa]);
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Codon counts summed by amino acid, sorted by one-letter code.
+ */
+std::vector<std::pair<char, size_t>> amino_acid_counts(
+    const codon_counts_t& counts, const std::string& code) {
+    std::map<char, size_t> aas;
+    for(size_t i = 0; i < N_CODONS; ++i) {
+        aas[code[i]] += counts.counts[i];
+    }
+    return {aas.begin(), aas.end()};
+}
+
+/**
+ * @brief Codon usage in total, by file or by sequence.
+ *
+ * @details Codons are read in frame from the first position; with
+ * `discard_gaps` gaps are removed first, otherwise codons containing a
+ * gap are skipped.
+ */
+std::vector<std::pair<std::string, codon_counts_t>> codons(
+    const sasi::args_t& args) {
+    // reject unknown codes before reading any input
+    genetic_code(args.genetic_code);
+    return by_detail<codon_counts_t>(args, args.codon_inf, "seq::codons",
+                                     args.discard_gaps, count_codons);
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_codons") {
+    auto index = [](std::string_view codon) {
+        return 16U * NUC_INDEX[static_cast<unsigned char>(codon[0])] +
+               4U * NUC_INDEX[static_cast<unsigned char>(codon[1])] +
+               NUC_INDEX[static_cast<unsigned char>(codon[2])];
+    };
+    SUBCASE("genetic codes") {
+        for(const auto& [id, table] : NCBI_CODES) {
+            CHECK(table.size() == N_CODONS);
+        }
+        std::string code = genetic_code(1);
+        CHECK(code[index("ATG")] == 'M');
+        CHECK(code[index("TGG")] == 'W');
+        CHECK(code[index("AAA")] == 'K');
+        CHECK(code[index("GGC")] == 'G');
+        CHECK(code[index("TGA")] == '*');
+        for(size_t i = 0; i < N_CODONS; ++i) {
+            std::string codon = codon_name(i);
+            CHECK(index(codon) == i);
+            CHECK((code[i] == '*') == is_stop(codon[0], codon[1], codon[2]));
+        }
+        CHECK(genetic_code(2)[index("TGA")] == 'W');
+        CHECK(genetic_code(2)[index("AGA")] == '*');
+        CHECK_THROWS_AS(genetic_code(7), std::invalid_argument);
+    }
+    SUBCASE("count, rscu and amino acids") {
+        codon_counts_t counts;
+        count_codons("ATGaaaAAG-AANAAAAAAAGTT", counts);
+        CHECK(counts.counts[index("ATG")] == 1);
+        CHECK(counts.counts[index("AAA")] == 2);
+        CHECK(counts.counts[index("AAG")] == 2);
+        CHECK(std::accumulate(counts.counts.begin(), counts.counts.end(),
+                              size_t{0}) == 5);
+        std::string code = genetic_code(1);
+        auto values = rscu(counts, code);
+        CHECK(values[index("ATG")] == doctest::Approx(1.0));
+        CHECK(values[index("AAA")] == doctest::Approx(1.0));
+        CHECK(values[index("GGG")] == doctest::Approx(0.0));
+        counts.counts[index("AAA")] = 3;
+        CHECK(rscu(counts, code)[index("AAG")] == doctest::Approx(0.8));
+        auto aas = amino_acid_counts(counts, code);
+        REQUIRE(aas.size() == 21);
+        CHECK(aas.front().first == '*');
+        CHECK(std::find(aas.begin(), aas.end(), std::make_pair('K', size_t{5}))
+              != aas.end());
+    }
+    SUBCASE("by file and by sequence") {
+        std::ofstream out;
+        out.open("test-codons.fa");
+        REQUIRE(out);
+        out << ">1\nATG AAA --- TAA\n>2\nA-T GAA A\n";
+        out.close();
+        sasi::args_t args;
+        args.input = {"test-codons.fa"};
+        args.codon_inf = info_detail::SEQ;
+        auto rows = codons(args);
+        REQUIRE(rows.size() == 2);
+        CHECK(rows[0].first == "test-codons.fa,1");
+        CHECK(rows[0].second.counts[index("ATG")] == 1);
+        CHECK(rows[0].second.counts[index("TAA")] == 1);
+        CHECK(rows[1].second.counts[index("GAA")] == 1);
+        CHECK(rows[1].second.counts[index("ATG")] == 0);
+
+        args.discard_gaps = true;
+        args.codon_inf = info_detail::FILE;
+        rows = codons(args);
+        REQUIRE(rows.size() == 1);
+        CHECK(rows[0].second.counts[index("ATG")] == 2);
+        CHECK(rows[0].second.counts[index("AAA")] == 2);
+
+        args.genetic_code = 99;
+        CHECK_THROWS_AS(codons(args), std::invalid_argument);
+        REQUIRE(std::filesystem::remove("test-codons.fa"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+namespace {
+// sequences per side of a tile of pairs
+constexpr size_t DIST_TILE{16};
+// words of each bit plane processed per pass over a tile
+constexpr size_t DIST_CHUNK{512};
+
+size_t popcount(std::uint64_t x) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcountll(x));
+#else
+    return std::bitset<64>(x).count();
+#endif
+}
+
+// mismatches, compared sites and shared gaps of a pair of sequences
+struct pair_counts_t {
+    size_t diff{0};
+    size_t both{0};
+    size_t gaps{0};
+};
+
+// low and high bit of the 2-bit base code, an A/C/G/T mask and a gap mask,
+// one word per 64 sites for each sequence
+struct bit_planes_t {
+    size_t words{0};
+    std::vector<std::uint64_t> lo, hi, valid, gap;
+
+    bit_planes_t(const std::vector<std::string>& seqs, size_t length)
+        : words{(length + 63) / 64},
+          lo(seqs.size() * words, 0),
+          hi(seqs.size() * words, 0),
+          valid(seqs.size() * words, 0),
+          gap(seqs.size() * words, 0) {
+        for(size_t s = 0; s < seqs.size(); ++s) {
+            for(size_t i = 0; i < length; ++i) {
+                std::uint64_t code =
+                    NUC_INDEX[static_cast<unsigned char>(seqs[s][i])];
+                std::uint64_t bit = std::uint64_t{1} << (i % 64);
+                size_t w = s * words + i / 64;
+                std::uint64_t ok = code < 4 ? bit : 0;
+                lo[w] |= (code & 1U) != 0 ? ok : 0;
+                hi[w] |= (code & 2U) != 0 ? ok : 0;
+                valid[w] |= ok;
+                gap[w] |= seqs[s][i] == GAP ? bit : 0;
+            }
+        }
+    }
+
+    // counts of sequences a and b in a word range
+    [[nodiscard]] pair_counts_t compare(size_t a, size_t b, size_t first,
+                                        size_t last) const {
+        const std::uint64_t* lo_a = &lo[a * words];
+        const std::uint64_t* hi_a = &hi[a * words];
+        const std::uint64_t* ok_a = &valid[a * words];
+        const std::uint64_t* gap_a = &gap[a * words];
+        const std::uint64_t* lo_b = &lo[b * words];
+        const std::uint64_t* hi_b = &hi[b * words];
+        const std::uint64_t* ok_b = &valid[b * words];
+        const std::uint64_t* gap_b = &gap[b * words];
+        pair_counts_t ret;
+        for(size_t w = first; w < last; ++w) {
+            std::uint64_t ok = ok_a[w] & ok_b[w];
+            ret.diff +=
+                popcount(((lo_a[w] ^ lo_b[w]) | (hi_a[w] ^ hi_b[w])) & ok);
+            ret.both += popcount(ok);
+            ret.gaps += popcount(gap_a[w] & gap_b[w]);
+        }
+        return ret;
+    }
+};
+}  // namespace
+
+/**
+ * @brief Pairwise mismatches, compared sites and shared gaps of one
+ * alignment.
+ *
+ * @details Sequences are encoded into bit planes; for a pair, sites with
+ * A/C/G/T in both are `valid_x & valid_y`, mismatches are the subset
+ * where either base bit differs and shared gaps are `gap_x & gap_y`, all
+ * counted with popcount. Pairs are split
+ * into tiles of `DIST_TILE` x `DIST_TILE` sequences run on `threads`
+ * workers, and each tile walks the planes in chunks that stay in cache.
+ */
+distance_matrix_t distance(const sasi::data_t& data, size_t threads) {
+    size_t n = data.seqs.size();
+    size_t length = n == 0 ? 0 : data.seqs[0].size();
+    for(const auto& seq : data.seqs) {
+        if(seq.size() != length) {
+            throw std::invalid_argument(
+                "Alignments must have equal length sequences.");
+        }
+    }
+    distance_matrix_t dist;
+    dist.names = data.names;
+    dist.mismatches.assign(n < 2 ? 0 : n * (n - 1) / 2, 0);
+    dist.compared.assign(dist.mismatches.size(), 0);
+    dist.gaps.assign(dist.mismatches.size(), 0);
+    if(n < 2) {
+        return dist;
+    }
+
+    const bit_planes_t planes(data.seqs, length);
+    size_t words = planes.words;
+    size_t tiles = (n + DIST_TILE - 1) / DIST_TILE;
+    sasi::sched::pool_t pool(threads);
+    size_t task{0};
+    for(size_t ti = 0; ti < tiles; ++ti) {
+        for(size_t tj = ti; tj < tiles; ++tj) {
+            pool.push(task++, [&, ti, tj](size_t /*worker*/) {
+                size_t i_end = std::min(n, (ti + 1) * DIST_TILE);
+                size_t j_end = std::min(n, (tj + 1) * DIST_TILE);
+                for(size_t c = 0; c < words; c += DIST_CHUNK) {
+                    size_t c_end = std::min(words, c + DIST_CHUNK);
+                    for(size_t i = ti * DIST_TILE; i < i_end; ++i) {
+                        for(size_t j = std::max(i + 1, tj * DIST_TILE);
+                            j < j_end; ++j) {
+                            auto counts = planes.compare(i, j, c, c_end);
+                            size_t k = dist.pair(i, j);
+                            dist.mismatches[k] += counts.diff;
+                            dist.compared[k] += counts.both;
+                            dist.gaps[k] += counts.gaps;
+                        }
+                    }
+                }
+            });
+        }
+    }
+    pool.run();
+    return dist;
+}
+
+/**
+ * @brief Pairwise distances of every input alignment, in input order.
+ */
+std::vector<distance_matrix_t> distance(const sasi::args_t& args) {
+    std::vector<distance_matrix_t> ret;
+    ret.reserve(args.input.size());
+    for(const auto& file : args.input) {
+        sasi::data_t data = sasi::fasta::read_fasta(file, args);
+        sasi::profile::scope prof{"seq::distance", file};
+        prof.add(data.bases(), data.seqs.size());
+        ret.push_back(distance(data, sasi::utils::thread_count(args.threads)));
+        ret.back().file = file;
+    }
+    return ret;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_distance") {
+    SUBCASE("small alignment") {
+        sasi::data_t data;
+        data.names = {"a", "b", "c", "d"};
+        data.seqs = {"ACGTACGTAC", "ACGTTCGTA-", "NNGTACCTAC", "----------"};
+        distance_matrix_t dist = distance(data, 2);
+        REQUIRE(dist.mismatches.size() == 6);
+        // a-b: 9 compared, 1 mismatch; a-c: 8, 1; b-c: 7, 2
+        CHECK(dist.compared[dist.pair(0, 1)] == 9);
+        CHECK(dist.mismatches[dist.pair(0, 1)] == 1);
+        CHECK(dist.p(1, 0) == doctest::Approx(1.0 / 9));
+        CHECK(dist.p(0, 2) == doctest::Approx(1.0 / 8));
+        CHECK(dist.p(1, 2) == doctest::Approx(2.0 / 7));
+        CHECK(dist.p(2, 2) == 0.0);
+        CHECK(std::isnan(dist.p(0, 3)));
+        // b-d share the last gap, d is all gaps
+        CHECK(dist.gaps[dist.pair(1, 3)] == 1);
+        CHECK(dist.gaps[dist.pair(0, 3)] == 0);
+        CHECK(dist.gaps[dist.pair(0, 1)] == 0);
+    }
+    SUBCASE("tiles match naive count") {
+        // more sequences than one tile and longer than one chunk of words
+        std::mt19937 gen(42);  // NOLINT
+        std::uniform_int_distribution<size_t> pick(0, 5);
+        const std::string alphabet{"ACGT-N"};
+        sasi::data_t data;
+        for(size_t s = 0; s < 2 * DIST_TILE + 3; ++s) {
+            data.names.push_back(std::to_string(s));
+            std::string seq(64 * DIST_CHUNK + 70, 'A');
+            for(auto& c : seq) {
+                c = alphabet[pick(gen)];
+            }
+            data.seqs.push_back(seq);
+        }
+        distance_matrix_t dist = distance(data, 3);
+        bool all_equal{true};
+        for(size_t i = 0; i < data.seqs.size(); ++i) {
+            for(size_t j = i + 1; j < data.seqs.size(); ++j) {
+                size_t diff{0}, both{0}, gaps{0};
+                for(size_t k = 0; k < data.seqs[i].size(); ++k) {
+                    char a = data.seqs[i][k], b = data.seqs[j][k];
+                    if(alphabet.find(a) < 4 && alphabet.find(b) < 4) {
+                        both++;
+                        diff += static_cast<size_t>(a != b);
+                    }
+                    gaps += static_cast<size_t>(a == GAP && b == GAP);
+                }
+                all_equal &= dist.compared[dist.pair(i, j)] == both &&
+                             dist.mismatches[dist.pair(i, j)] == diff &&
+                             dist.gaps[dist.pair(i, j)] == gaps;
+            }
+        }
+        CHECK(all_equal);
+    }
+    SUBCASE("unaligned input") {
+        sasi::data_t data;
+        data.names = {"a", "b"};
+        data.seqs = {"ACGT", "ACG"};
+        CHECK_THROWS_AS(distance(data), std::invalid_argument);
+    }
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Estimate a count table from sampled records.
+ *
+ * @details Cells are the ambiguous nucleotides and, with `-q`, low quality
+ * bases (AMB), the sequences whose length is not a multiple of 3 and all
+ * sequences (FRMST), the early stop codons (STOP), the bases of each class
+ * (COMP) or the codons or amino acids (CODON), in total or by file as `-i`
+ * asks. Each cell is estimated by
+ * `sample::cells` from its per-record counts, with a 95% confidence
+ * interval; without sampling the interval is empty. Gaps are removed as in
+ * the exact counts.
+ *
+ * @throws std::invalid_argument for sequence detail or RSCU, which are not
+ * totals over records.
+ */
+sasi::sample::table_t estimate(const sasi::args_t& args, verb statistic) {
+    info_detail detail{info_detail::TOTAL};
+    if(statistic == verb::STOP) {
+        detail = args.stop_inf;
+    } else if(statistic == verb::COMP) {
+        detail = args.comp_inf;
+    } else if(statistic == verb::CODON) {
+        detail = args.codon_inf;
+    }
+    if(detail == info_detail::SEQ || (statistic == verb::CODON && args.rscu)) {
+        throw std::invalid_argument(
+            "Sampled counts are estimated in total or by file, without "
+            "--rscu.");
+    }
+    const std::string code =
+        statistic == verb::CODON ? genetic_code(args.genetic_code) : "";
+    bool degap = args.discard_gaps && statistic != verb::AMB &&
+                 statistic != verb::COMP;
+
+    auto cells = sasi::sample::cells<size_t>(
+        args, "seq::estimate",
+        [&args, &code, statistic, degap](const sasi::sched::batch_t& batch,
+                                         size_t i, auto&& add) {
+            std::string_view seq = batch.seq(i);
+            std::string degapped;
+            if(degap) {
+                batch.gaps().degap(i, seq, degapped);
+                seq = degapped;
+            }
+            switch(statistic) {
+                case verb::AMB:
+                    add(0, count_ambiguous(seq));
+                    add(1, sasi::fastq::count_below(batch.qual(i),
+                                                    args.min_quality,
+                                                    args.phred_offset));
+                    break;
+                case verb::FRMST:
+                    add(0, static_cast<size_t>(seq.length() % 3 != 0));
+                    add(1, 1);
+                    break;
+                case verb::STOP:
+                    add(0, count_stops(seq, args.stop_keep_last));
+                    break;
+                case verb::COMP: {
+                    composition_t comp = count_bases(seq);
+                    comp.low_quality = sasi::fastq::count_below(
+                        batch.qual(i), args.min_quality, args.phred_offset);
+                    const std::array<size_t, 8> classes{
+                        comp.a, comp.c, comp.g, comp.t, comp.gaps,
+                        comp.ambiguous, comp.other, comp.low_quality};
+                    for(size_t b = 0; b < classes.size(); ++b) {
+                        add(b, classes[b]);
+                    }
+                    break;
+                }
+                case verb::CODON: {
+                    codon_counts_t counts;
+                    count_codons(seq, counts);
+                    if(args.amino_acids) {
+                        for(const auto& [aa, count] :
+                            amino_acid_counts(counts, code)) {
+                            add(static_cast<unsigned char>(aa), count);
+                        }
+                        break;
+                    }
+                    for(size_t c = 0; c < N_CODONS; ++c) {
+                        add(c, counts.counts[c]);
+                    }
+                    break;
+                }
+            }
+        });
+
+    // cells in the order of the exact table, with their labels
+    std::string labels{"statistic"};
+    std::vector<std::pair<size_t, std::string>> keys;
+    if(statistic == verb::AMB) {
+        keys.emplace_back(0, "ambiguous_nucleotides");
+        if(args.min_quality > 0) {
+            keys.emplace_back(1, "low_quality_bases");
+        }
+    } else if(statistic == verb::FRMST) {
+        keys = {{0, "frameshifts"}, {1, "total"}};
+    } else if(statistic == verb::STOP) {
+        keys.emplace_back(0, "stop_codons");
+    } else if(statistic == verb::COMP) {
+        labels = "base";
+        const std::array<const char*, 8> bases{
+            "A", "C", "G", "T", "gaps", "ambiguous", "other", "low_quality"};
+        for(size_t b = 0; b < bases.size() - (args.min_quality > 0 ? 0 : 1);
+            ++b) {
+            keys.emplace_back(b, bases[b]);
+        }
+    } else if(args.amino_acids) {
+        labels = "amino_acid";
+        for(const auto& [aa, count] :
+            amino_acid_counts(codon_counts_t{}, code)) {
+            keys.emplace_back(static_cast<unsigned char>(aa),
+                              std::string(1, aa));
+        }
+    } else {
+        labels = "codon,amino_acid";
+        for(size_t c = 0; c < N_CODONS; ++c) {
+            keys.emplace_back(c, codon_name(c) + "," + code[c]);
+        }
+    }
+
+    sasi::sample::table_t table;
+    if(detail == info_detail::FILE) {
+        table.labels = "filename," + labels;
+        for(size_t f = 0; f < args.input.size(); ++f) {
+            if(cells.files[f].records == 0) {
+                continue;
+            }
+            for(const auto& [key, label] : keys) {
+                table.rows.emplace_back(
+                    args.input[f] + "," + label,
+                    sasi::sample::total({cells.stratum(key, f)}));
+            }
+        }
+    } else {
+        table.labels = labels;
+        for(const auto& [key, label] : keys) {
+            table.rows.emplace_back(label, cells.total(key));
+        }
+    }
+    return table;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_estimate") {
+    std::ofstream out;
+    out.open("test-estimate.fa");
+    REQUIRE(out);
+    for(size_t i = 0; i < 400; ++i) {
+        out << ">" << i << "\n" << (i % 2 == 0 ? "ANNTAAGG\n" : "ACGTAA\n");
+    }
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-estimate.fa"};
+    // full input: exact totals
+    auto est = estimate(args, verb::AMB).rows[0].second;
+    CHECK(est.value == doctest::Approx(400.0));
+    CHECK(est.high == doctest::Approx(est.low));
+    CHECK(est.sampled == 400);
+    CHECK(estimate(args, verb::FRMST).rows[0].second.value ==
+          doctest::Approx(200.0));
+    CHECK(estimate(args, verb::STOP).rows[0].second.value ==
+          doctest::Approx(200.0));
+    args.stop_keep_last = true;
+    CHECK(estimate(args, verb::STOP).rows[0].second.value ==
+          doctest::Approx(400.0));
+
+    args.sample_fraction = 0.5;
+    est = estimate(args, verb::FRMST).rows[0].second;
+    CHECK(est.records == 400);
+    CHECK(est.sampled < 400);
+    CHECK(est.low <= 200.0);
+    CHECK(est.high >= 200.0);
+
+    args.sample_fraction = 1.0;
+    args.sample_records = 100;
+    args.threads = 2;
+    est = estimate(args, verb::AMB).rows[0].second;
+    CHECK(est.sampled == 100);
+    CHECK(est.records == 400);
+    CHECK(est.low <= 400.0);
+    CHECK(est.high >= 400.0);
+
+    // files are sampled separately: 1000 frameshifted records, 10 in frame
+    out.open("test-estimate-2.fa");
+    REQUIRE(out);
+    for(size_t i = 0; i < 1000; ++i) {
+        out << ">" << i << "\nACGT\n";
+    }
+    out.close();
+    out.open("test-estimate-3.fa");
+    REQUIRE(out);
+    for(size_t i = 0; i < 10; ++i) {
+        out << ">" << i << "\nACG\n";
+    }
+    out.close();
+    args.input = {"test-estimate-2.fa", "test-estimate-3.fa"};
+    args.sample_records = 10;
+    est = estimate(args, verb::FRMST).rows[0].second;
+    CHECK(est.value == doctest::Approx(1000.0));
+    CHECK(est.low == doctest::Approx(1000.0));
+    CHECK(est.high == doctest::Approx(1000.0));
+    CHECK(est.sampled == 20);
+    CHECK(est.records == 1010);
+    // a file left without sampled records still counts its records
+    args.sample_records = 0;
+    args.sample_fraction = 0.05;
+    for(std::uint64_t seed = 0; seed < 8; ++seed) {
+        args.seed = seed;
+        CHECK(estimate(args, verb::FRMST).rows[0].second.records == 1010);
+    }
+
+    // count tables by file agree with the exact counts
+    args.seed = 0;
+    args.sample_fraction = 1.0;
+    args.input = {"test-estimate.fa", "test-estimate-3.fa"};
+    args.comp_inf = info_detail::FILE;
+    args.codon_inf = info_detail::FILE;
+    auto table = estimate(args, verb::COMP);
+    CHECK(table.labels == "filename,base");
+    REQUIRE(table.rows.size() == 14);
+    auto comps = composition(args);
+    CHECK(table.rows[0].first == "test-estimate.fa,A");
+    CHECK(table.rows[0].second.value == doctest::Approx(comps[0].second.a));
+    CHECK(table.rows[9].first == "test-estimate-3.fa,G");
+    CHECK(table.rows[9].second.value == doctest::Approx(comps[1].second.g));
+    table = estimate(args, verb::CODON);
+    REQUIRE(table.rows.size() == 2 * N_CODONS);
+    auto codon_rows = codons(args);
+    for(size_t c = 0; c < N_CODONS; ++c) {
+        CHECK(table.rows[c].second.value ==
+              doctest::Approx(codon_rows[0].second.counts[c]));
+    }
+    args.amino_acids = true;
+    table = estimate(args, verb::CODON);
+    CHECK(table.labels == "filename,amino_acid");
+    CHECK(table.rows.front().first == "test-estimate.fa,*");
+    args.rscu = true;
+    CHECK_THROWS_AS(estimate(args, verb::CODON), std::invalid_argument);
+    args.comp_inf = info_detail::SEQ;
+    CHECK_THROWS_AS(estimate(args, verb::COMP), std::invalid_argument);
+    REQUIRE(std::filesystem::remove("test-estimate.fa"));
+    REQUIRE(std::filesystem::remove("test-estimate-2.fa"));
+    REQUIRE(std::filesystem::remove("test-estimate-3.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Groups of identical sequences in each input file.
+ *
+ * @details Sequences are compared whole, or without gaps with
+ * `discard_gaps`. `--dedup` and sampling do not apply here.
+ *
+ * @return std::vector<std::pair<std::string, std::vector<std::string>>>
+ * file name and sequence names of every group, in input order.
+ */
+std::vector<std::pair<std::string, std::vector<std::string>>> duplicates(
+    const sasi::args_t& args) {
+    std::vector<std::pair<std::string, std::vector<std::string>>> ret;
+    for(const auto& file : args.input) {
+        sasi::data_t data =
+            sasi::fasta::read_fasta(file, args.ignore_empty, args.threads);
+        sasi::profile::scope prof{"seq::duplicates", file};
+        prof.add(data.bases(), data.seqs.size());
+        for(const auto& group :
+            sasi::dedup::groups(data, args.discard_gaps,
+                                sasi::utils::thread_count(args.threads))) {
+            std::vector<std::string> names;
+            names.reserve(group.size());
+            for(size_t i : group) {
+                names.push_back(data.names[i]);
+            }
+            ret.emplace_back(file, std::move(names));
+        }
+    }
+    return ret;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_duplicates") {
+    std::ofstream out;
+    out.open("test-dup.fa");
+    REQUIRE(out);
+    out << ">a\nAC-GT\n>b\nACGT\n>c\nAC-GT\n>d\nTTT\n>e\nACGT-\n";
+    out.close();
+
+    sasi::args_t args;
+    args.input = {"test-dup.fa"};
+    using groups_t =
+        std::vector<std::pair<std::string, std::vector<std::string>>>;
+    groups_t expected{{"test-dup.fa", {"a", "c"}}};
+    CHECK(duplicates(args) == expected);
+    args.discard_gaps = true;
+    expected = {{"test-dup.fa", {"a", "b", "c", "e"}}};
+    CHECK(duplicates(args) == expected);
+
+    // --dedup counts duplicates once in other statistics
+    args.discard_gaps = false;
+    CHECK(frameshift(args) == std::pair<size_t, size_t>{4, 5});
+    args.dedup = true;
+    CHECK(frameshift(args) == std::pair<size_t, size_t>{3, 4});
+    REQUIRE(std::filesystem::remove("test-dup.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Whether one sequence passes the filters of args.
+ *
+ * @details Cheapest checks first: gap fraction (`--max-gap-fraction`),
+ * frameshift (`--no-frameshift`), ambiguous nucleotides
+ * (`--max-ambiguous`) and early stop codons (`--no-stops`). With `-g` the
+ * gap fraction is taken from the aligned sequence and the other checks run
+ * on the sequence without gaps, as in the sequence statistics.
+ */
+bool passes(std::string_view seq, const sasi::args_t& args) {
+    return passes(sasi::gap::mask_t(seq), 0, seq, args);
+}
+
+/**
+ * @brief Whether record r, whose characters are seq, passes the filters of
+ * args, with its gaps counted and removed through gaps.
+ */
+bool passes(const sasi::gap::mask_t& gaps, size_t r, std::string_view seq,
+            const sasi::args_t& args) {
+    if(args.max_gap_fraction < 1.0 && !seq.empty() &&
+       static_cast<double>(gaps.count(r)) >
+           args.max_gap_fraction * static_cast<double>(seq.size())) {
+        return false;
+    }
+    std::string degapped;
+    if(args.discard_gaps) {
+        gaps.degap(r, seq, degapped);
+        seq = degapped;
+    }
+    if(args.no_frameshift && seq.size() % 3 != 0) {
+        return false;
+    }
+    if(args.max_ambiguous != SIZE_MAX &&
+       count_ambiguous(seq) > args.max_ambiguous) {
+        return false;
+    }
+    return !args.no_stops || count_stops(seq, args.stop_keep_last) == 0;
+}
+
+/**
+ * @brief Apply the record filters of args to every input file.
+ *
+ * @details Files are read in input order and their records checked on
+ * `args.threads` workers; fn receives each file with one keep flag per
+ * record.
+ */
+void filter(const sasi::args_t& args, const filter_fn_t& fn) {
+    constexpr size_t FILTER_BATCH{1024};
+    size_t threads = sasi::utils::thread_count(args.threads);
+    for(const auto& file : args.input) {
+        sasi::data_t data = sasi::fasta::read_fasta(file, args);
+        size_t n = data.seqs.size();
+        std::vector<char> keep(n, 0);
+        {
+            sasi::profile::scope prof{"seq::filter", file};
+            prof.add(data.bases(), n);
+            sasi::sched::pool_t pool(threads);
+            for(size_t first = 0; first < n; first += FILTER_BATCH) {
+                pool.push(first / FILTER_BATCH, [&, first](size_t /*w*/) {
+                    size_t last = std::min(n, first + FILTER_BATCH);
+                    sasi::gap::mask_t gaps(data, first, last);
+                    for(size_t i = first; i < last; ++i) {
+                        keep[i] = static_cast<char>(
+                            passes(gaps, i, data.seqs[i], args));
+                    }
+                });
+            }
+            pool.run();
+        }
+        fn(data, keep);
+    }
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("sequence_filter") {
+    sasi::args_t args;
+    SUBCASE("passes") {
+        CHECK(passes("ACGTNN", args));
+        args.max_ambiguous = 1;
+        CHECK_FALSE(passes("ACGTNN", args));
+        CHECK(passes("ACGTNA", args));
+        args.max_ambiguous = SIZE_MAX;
+        args.no_stops = true;
+        CHECK_FALSE(passes("TAAACG", args));
+        CHECK(passes("ACGTAA", args));
+        args.stop_keep_last = true;
+        CHECK_FALSE(passes("ACGTAA", args));
+        args.no_stops = false;
+        args.no_frameshift = true;
+        CHECK_FALSE(passes("AC-GT", args));
+        args.discard_gaps = true;
+        CHECK(passes("AC-GTA", args) == false);
+        CHECK(passes("AC-GTAT", args));
+        args.no_frameshift = false;
+        // stop codons of the degapped sequence, as in sequence stop -g
+        args.no_stops = true;
+        CHECK_FALSE(passes("AC-GTAAGG", args));
+        args.discard_gaps = false;
+        CHECK(passes("AC-GTAAGG", args));
+        args.no_stops = false;
+        args.max_gap_fraction = 0.25;
+        CHECK(passes("AC-G", args));
+        CHECK_FALSE(passes("AC--", args));
+    }
+    SUBCASE("files") {
+        std::ofstream out;
+        out.open("test-filter.fa");
+        REQUIRE(out);
+        out << ">a\nACGTAA\n>b\nTAAACG\n>c\nAC-GTN\n";
+        out.close();
+        args.input = {"test-filter.fa"};
+        args.no_stops = true;
+        args.max_gap_fraction = 0.1;
+        std::vector<std::vector<char>> seen;
+        filter(args, [&seen](const sasi::data_t& data,
+                             const std::vector<char>& keep) {
+            CHECK(data.size() == keep.size());
+            seen.push_back(keep);
+        });
+        CHECK(seen == std::vector<std::vector<char>>{{1, 0, 0}});
+        REQUIRE(std::filesystem::remove("test-filter.fa"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Call fn for every input file with its records translated.
+ *
+ * @details Records are degapped with `discard_gaps`, then translated in
+ * `args.frame` (1-3 forward, 4-6 reverse complement) or, with
+ * `six_frames`, in all six frames with "_frame=N" appended to the names.
+ */
+void translate(const sasi::args_t& args,
+               const std::function<void(const sasi::data_t&)>& fn) {
+    constexpr size_t TRANSLATE_BATCH{256};
+    const codon_table_t table = codon_table(genetic_code(args.genetic_code));
+    std::vector<size_t> frames{args.frame};
+    if(args.six_frames) {
+        frames = {1, 2, 3, 4, 5, 6};
+    }
+    size_t threads = sasi::utils::thread_count(args.threads);
+    for(const auto& file : args.input) {
+        sasi::data_t data = sasi::fasta::read_fasta(file, args);
+        size_t n = data.seqs.size();
+        sasi::data_t protein(file);
+        protein.names.resize(n * frames.size());
+        protein.seqs.resize(n * frames.size());
+        {
+            sasi::profile::scope prof{"seq::translate", file};
+            prof.add(data.bases(), n);
+            sasi::sched::pool_t pool(threads);
+            for(size_t first = 0; first < n; first += TRANSLATE_BATCH) {
+                pool.push(first / TRANSLATE_BATCH, [&, first](size_t /*w*/) {
+                    size_t last = std::min(n, first + TRANSLATE_BATCH);
+                    sasi::gap::mask_t gaps;
+                    if(args.discard_gaps) {
+                        gaps = sasi::gap::mask_t(data, first, last);
+                    }
+                    for(size_t r = first; r < last; ++r) {
+                        std::string seq;
+                        if(args.discard_gaps) {
+                            gaps.degap(r, data.seqs[r], seq);
+                        } else {
+                            seq = data.seqs[r];
+                        }
+                        std::string reverse;
+                        for(size_t k = 0; k < frames.size(); ++k) {
+                            size_t frame = frames[k];
+                            if(frame > 3 && reverse.empty()) {
+                                reverse = reverse_complement(seq);
+                            }
+                            std::string_view source{frame > 3 ? reverse : seq};
+                            size_t offset = std::min((frame - 1) % 3,
+                                                     source.size());
+                            size_t out = r * frames.size() + k;
+                            protein.seqs[out] =
+                                translate(source.substr(offset), table);
+                            protein.names[out] =
+                                args.six_frames ? data.names[r] + "_frame=" +
+                                                      std::to_string(frame)
+                                                : data.names[r];
+                        }
+                    }
+                });
+            }
+            pool.run();
+        }
+        fn(protein);
+    }
+}
+
 }  // namespace sasi::seq
@@ -0,0 +1,372 @@
+/* Copyright (c) 2022 Juan J. Garcia Mesa <juanjosegarciamesa@gmail.com> */
+
+#include <doctest.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <mutex>
+#include <sasi/profile.hpp>
+#include <sasi/sequence.hpp>
+#include <sasi/tar.hpp>
+#include <stdexcept>
+
+namespace sasi::tar {
+
+namespace {
+// ustar header fields: offset and length
+constexpr size_t NAME{0}, NAME_LEN{100};
+constexpr size_t SIZE{124}, SIZE_LEN{12};
+constexpr size_t CHKSUM{148}, CHKSUM_LEN{8};
+constexpr size_t TYPE{156};
+constexpr size_t MAGIC{257};
+constexpr size_t PREFIX{345}, PREFIX_LEN{155};
+
+// NUL-terminated field of a header
+std::string_view field(std::string_view header, size_t offset, size_t len) {
+    std::string_view f = header.substr(offset, len);
+    return f.substr(0, std::min(f.find('\0'), f.size()));
+}
+
+// octal number, or base-256 (GNU) if the high bit of the first byte is set
+size_t number(std::string_view f) {
+    size_t value{0};
+    if((static_cast<unsigned char>(f[0]) & 0x80U) != 0) {
+        value = static_cast<unsigned char>(f[0]) & 0x7FU;
+        for(char c : f.substr(1)) {
+            value = (value << 8U) | static_cast<unsigned char>(c);
+        }
+        return value;
+    }
+    size_t i = std::min(f.find_first_not_of(" \0", 0, 2), f.size());
+    for(; i < f.size() && f[i] >= '0' && f[i] <= '7'; ++i) {
+        value = value * 8 + static_cast<size_t>(f[i] - '0');
+    }
+    return value;
+}
+
+// header checksum with the checksum field read as spaces, accepting the
+// unsigned and the historic signed byte sums
+bool valid_checksum(std::string_view header) {
+    size_t expected = number(header.substr(CHKSUM, CHKSUM_LEN));
+    size_t sum{CHKSUM_LEN * ' '};
+    long signed_sum{static_cast<long>(sum)};
+    for(size_t i = 0; i < BLOCK; ++i) {
+        if(i >= CHKSUM && i < CHKSUM + CHKSUM_LEN) {
+            continue;
+        }
+        sum += static_cast<unsigned char>(header[i]);
+        signed_sum += static_cast<signed char>(header[i]);
+    }
+    return sum == expected || signed_sum == static_cast<long>(expected);
+}
+
+// name of a header, with the ustar prefix if there is one
+std::string header_name(std::string_view header) {
+    std::string name{field(header, NAME, NAME_LEN)};
+    std::string_view prefix = field(header, PREFIX, PREFIX_LEN);
+    if(header.substr(MAGIC, 5) == "ustar" && !prefix.empty()) {
+        name = std::string{prefix} + "/" + name;
+    }
+    return name;
+}
+
+// "path" record of pax extended header data ("LEN key=value\n" records)
+std::string pax_path(std::string_view data) {
+    constexpr std::string_view KEY{"path="};
+    size_t pos{0};
+    while(pos < data.size()) {
+        size_t space = data.find(' ', pos);
+        if(space == std::string_view::npos) {
+            break;
+        }
+        size_t len{0};
+        for(size_t i = pos; i < space; ++i) {
+            if(std::isdigit(static_cast<unsigned char>(data[i])) == 0) {
+                return {};
+            }
+            len = len * 10 + static_cast<size_t>(data[i] - '0');
+        }
+        if(len < space - pos + 2 || len > data.size() - pos) {
+            break;
+        }
+        std::string_view record = data.substr(space + 1, pos + len - space - 2);
+        if(record.substr(0, KEY.size()) == KEY) {
+            return std::string{record.substr(KEY.size())};
+        }
+        pos += len;
+    }
+    return {};
+}
+}  // namespace
+
+/**
+ * @brief Regular files of a tar archive in archive order.
+ *
+ * @details Reads ustar, GNU and pax archives: names longer than 100
+ * characters come from the ustar prefix, a GNU long name ('L') or a pax
+ * "path" record. Directories, links and other special members are
+ * skipped. Reading stops at the first zero block.
+ *
+ * @throws std::invalid_argument on a bad header checksum or a member
+ * extending past the end of the archive.
+ */
+std::vector<member_t> index(std::string_view buffer, const std::string& path) {
+    std::vector<member_t> members;
+    std::string long_name;
+    size_t pos{0};
+    while(pos + BLOCK <= buffer.size()) {
+        std::string_view header = buffer.substr(pos, BLOCK);
+        if(std::all_of(header.begin(), header.end(),
+                       [](char c) { return c == '\0'; })) {
+            break;
+        }
+        if(!valid_checksum(header)) {
+            throw std::invalid_argument("Corrupt tar header at byte " +
+                                        std::to_string(pos) + " of " + path +
+                                        ".");
+        }
+        size_t size = number(header.substr(SIZE, SIZE_LEN));
+        size_t data = pos + BLOCK;
+        if(size > buffer.size() - data) {
+            throw std::invalid_argument("Truncated tar archive " + path +
+                                        ".");
+        }
+        switch(header[TYPE]) {
+        case 'L':
+            long_name = field(buffer.substr(data, size), 0, size);
+            break;
+        case 'x':
+            if(auto name = pax_path(buffer.substr(data, size));
+               !name.empty()) {
+                long_name = std::move(name);
+            }
+            break;
+        case '0':
+        case '\0':
+        case '7': {
+            std::string name =
+                long_name.empty() ? header_name(header) : long_name;
+            while(name.substr(0, 2) == "./") {
+                name.erase(0, 2);
+            }
+            members.push_back(member_t{std::move(name), data, size});
+            long_name.clear();
+            break;
+        }
+        default:  // directories, links, pax global headers
+            long_name.clear();
+        }
+        pos = data + (size + BLOCK - 1) / BLOCK * BLOCK;
+    }
+    return members;
+}
+
+archive_t::archive_t(const std::string& path) : path_{path}, input_{path} {
+    sasi::profile::scope prof{"tar::index", path};
+    members_ = index(input_.view(), path);
+    lookup_.reserve(members_.size());
+    for(size_t i = 0; i < members_.size(); ++i) {
+        lookup_[members_[i].name] = i;  // later copies replace earlier ones
+    }
+    prof.add(input_.view().size(), members_.size());
+}
+
+/**
+ * @brief Member called name (the last one if it appears more than once).
+ *
+ * @throws std::invalid_argument if there is no such member.
+ */
+const member_t& archive_t::member(std::string_view name) const {
+    auto it = lookup_.find(name);
+    if(it == lookup_.end()) {
+        throw std::invalid_argument("No member " + std::string{name} +
+                                    " in tar archive " + path_ + ".");
+    }
+    return members_[it->second];
+}
+
+/**
+ * @brief Whether an extension from `extract_file_type` names a tar archive.
+ */
+bool is_tar(std::string_view type_ext) {
+    std::string ext{type_ext};
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return ext == ".tar";
+}
+
+/**
+ * @brief Split the path of a "tar:" input into archive and member name
+ * (empty for the whole archive).
+ */
+std::pair<std::string, std::string> split(const std::string& path) {
+    size_t colon = path.find(':');
+    if(colon == std::string::npos) {
+        return {path, ""};
+    }
+    return {path.substr(0, colon), path.substr(colon + 1)};
+}
+
+/**
+ * @brief Archive at path, mapped and indexed once per process.
+ *
+ * @details Every member of an expanded archive is read by its own task, so
+ * archives are cached and shared between them.
+ */
+std::shared_ptr<const archive_t> open(const std::string& path) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const archive_t>>
+        archives;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& archive = archives[path];
+    if(!archive) {
+        archive = std::make_shared<const archive_t>(path);
+    }
+    return archive;
+}
+
+/**
+ * @brief Bytes of a member ("archive:member") or of all members of an
+ * archive, 0 if it cannot be read.
+ */
+size_t input_size(const std::string& path) {
+    try {
+        auto [archive_path, name] = split(path);
+        auto archive = open(archive_path);
+        if(!name.empty()) {
+            return archive->member(name).size;
+        }
+        size_t total{0};
+        for(const auto& member : archive->members()) {
+            total += member.size;
+        }
+        return total;
+    } catch(const std::invalid_argument&) {
+        return 0;
+    }
+}
+
+/**
+ * @brief Replace every "tar:archive" input by one "tar:archive:member"
+ * input per regular file of the archive, in archive order.
+ *
+ * @details Members then count as separate input files: they are
+ * distributed over the worker threads and reported by name.
+ */
+std::vector<std::string> expand(const std::vector<std::string>& inputs) {
+    std::vector<std::string> ret;
+    ret.reserve(inputs.size());
+    for(const auto& input : inputs) {
+        sasi::file_type_t in_type = sasi::utils::extract_file_type(input);
+        if(!is_tar(in_type.type_ext) || !split(in_type.path).second.empty()) {
+            ret.push_back(input);
+            continue;
+        }
+        auto archive = open(in_type.path);
+        for(const auto& member : archive->members()) {
+            if(&archive->member(member.name) == &member) {
+                ret.push_back("tar:" + in_type.path + ":" + member.name);
+            }
+        }
+    }
+    return ret;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("tar") {
+    // one archive entry: ustar header and data padded to whole blocks
+    auto entry = [](const std::string& name, const std::string& data,
+                    char type = '0', const std::string& prefix = "") {
+        std::string header(BLOCK, '\0');
+        name.copy(header.data() + NAME, NAME_LEN);
+        std::snprintf(header.data() + SIZE, SIZE_LEN, "%011zo", data.size());
+        header[TYPE] = type;
+        std::string{"ustar"}.copy(header.data() + MAGIC, 5);
+        std::string{"00"}.copy(header.data() + MAGIC + 6, 2);
+        prefix.copy(header.data() + PREFIX, PREFIX_LEN);
+        std::fill_n(header.begin() + CHKSUM, CHKSUM_LEN, ' ');
+        size_t sum{0};
+        for(char c : header) {
+            sum += static_cast<unsigned char>(c);
+        }
+        std::snprintf(header.data() + CHKSUM, CHKSUM_LEN, "%06zo", sum);
+        std::string padding((BLOCK - data.size() % BLOCK) % BLOCK, '\0');
+        return header + data + padding;
+    };
+    std::string long_name = std::string(120, 'x') + ".fa";
+    std::string archive =
+        entry("./a/", "", '5') + entry("./a/one.fa", ">s1\nAC-T\n") +
+        entry("././@LongLink", long_name + '\0', 'L') +
+        entry("truncated", ">s2\nNNNN\n") +
+        entry("PaxHeader", "18 path=b/two.sto\n", 'x') +
+        entry("b/two.st", "# STOCKHOLM 1.0\ns3 AC.N\n//\n") +
+        entry("link", "", '2') +
+        entry("three.phy", "1 4\ns4 ACGN\n", '0', "deep/dir") +
+        std::string(2 * BLOCK, '\0');
+
+    SUBCASE("index") {
+        auto members = index(archive, "test.tar");
+        REQUIRE(members.size() == 4);
+        CHECK(members[0].name == "a/one.fa");
+        CHECK(members[1].name == long_name);
+        CHECK(members[2].name == "b/two.sto");
+        CHECK(members[3].name == "deep/dir/three.phy");
+        CHECK(archive.substr(members[0].offset, members[0].size) ==
+              ">s1\nAC-T\n");
+        CHECK(index("", "empty.tar").empty());
+    }
+    SUBCASE("errors") {
+        std::string corrupt = archive;
+        corrupt[BLOCK + 1] = 'z';
+        CHECK_THROWS_AS(index(corrupt), std::invalid_argument);
+        CHECK_THROWS_AS(index(entry("a.fa", std::string(BLOCK + 1, 'A'))
+                                  .substr(0, 2 * BLOCK)),
+                        std::invalid_argument);
+    }
+    SUBCASE("paths") {
+        CHECK(is_tar(".tar"));
+        CHECK(is_tar(".TAR"));
+        CHECK_FALSE(is_tar(".fa"));
+        CHECK(split("set.tar") == std::make_pair(std::string{"set.tar"},
+                                                 std::string{}));
+        CHECK(split("set.tar:g/1.fa") ==
+              std::make_pair(std::string{"set.tar"}, std::string{"g/1.fa"}));
+    }
+    SUBCASE("read members") {
+        std::ofstream out("test-archive.tar", std::ios::binary);
+        REQUIRE(out);
+        out << archive;
+        out.close();
+
+        auto one = sasi::fasta::read_fasta("tar:test-archive.tar:a/one.fa");
+        CHECK(one.names == std::vector<std::string>{"s1"});
+        CHECK(one.seqs == std::vector<std::string>{"AC-T"});
+        auto all = sasi::fasta::read_fasta("tar:test-archive.tar");
+        CHECK(all.names == std::vector<std::string>{"s1", "s2", "s3", "s4"});
+        CHECK(all.seqs ==
+              std::vector<std::string>{"AC-T", "NNNN", "AC-N", "ACGN"});
+        CHECK_THROWS_AS(sasi::fasta::read_fasta("tar:test-archive.tar:no.fa"),
+                        std::invalid_argument);
+        CHECK(input_size("test-archive.tar:a/one.fa") == 9);
+        CHECK(input_size("missing.tar") == 0);
+
+        sasi::args_t args;
+        args.input = expand({"tar:test-archive.tar", "other.fa"});
+        std::vector<std::string> expected{
+            "tar:test-archive.tar:a/one.fa",
+            "tar:test-archive.tar:" + long_name,
+            "tar:test-archive.tar:b/two.sto",
+            "tar:test-archive.tar:deep/dir/three.phy", "other.fa"};
+        CHECK(args.input == expected);
+        args.input.pop_back();
+        args.threads = 2;
+        CHECK(sasi::seq::ambiguous(args) == 6);
+        REQUIRE(std::filesystem::remove("test-archive.tar"));
+    }
+}
+// GCOVR_EXCL_STOP
+
+}  // namespace sasi::tar
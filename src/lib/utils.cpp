@@ -3,7 +3,9 @@
 #include <doctest.h>
 
 #include <filesystem>
+#include <sasi/tar.hpp>
 #include <sasi/utils.hpp>
+#include <thread>
 
 namespace sasi::utils {
 
@@ -77,37 +79,170 @@ TEST_CASE("extract_file_type") {
 }
 // GCOVR_EXCL_STOP
 
+/**
+ * @brief CLI::ExistingFile for inputs with an optional "ext:" prefix.
+ *
+ * @details "-" (stdin) is accepted, with or without a prefix. For
+ * "tar:archive:member" only the archive is checked.
+ */
+CLI::Validator existing_input() {
+    return CLI::Validator(
+        [](std::string& input) {
+            file_type_t in_type = extract_file_type(input);
+            std::string path = in_type.path;
+            if(sasi::tar::is_tar(in_type.type_ext)) {
+                path = sasi::tar::split(path).first;
+            }
+            if(path == "-") {
+                return std::string{};
+            }
+            return CLI::ExistingFile(path);
+        },
+        "FILE");
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("existing_input") {
+    std::ofstream out("test-input.fa");
+    REQUIRE(out);
+    out.close();
+    CLI::Validator check = existing_input();
+    std::string input = "test-input.fa";
+    CHECK(check(input).empty());
+    input = "phy:test-input.fa";
+    CHECK(check(input).empty());
+    input = "-";
+    CHECK(check(input).empty());
+    input = "phy:missing.phy";
+    CHECK_FALSE(check(input).empty());
+    input = "tar:test-input.fa:member.fa";
+    CHECK(check(input).empty());
+    input = "tar:missing.tar:member.fa";
+    CHECK_FALSE(check(input).empty());
+    REQUIRE(std::filesystem::remove("test-input.fa"));
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Write a histogram of counts to a file or stdout ("-").
+ *
+ * @param counts count of every value, indexed by value
+ * @param zeros include empty bins
+ * @param out_file output file, "-" for stdout
+ * @param bins binning scheme
+ * @param width bin width for linear bins
+ * @return int EXIT_SUCCESS, or EXIT_FAILURE if out_file cannot be opened.
+ */
+int write_histogram(const std::vector<size_t>& counts, bool zeros,
+                    const std::string& out_file, sasi::hist::binning bins,
+                    size_t width) {
+    sasi::hist::histogram_t hist;
+    for(size_t i = 0; i < counts.size(); ++i) {
+        if(counts[i] > 0) {
+            hist.add(i, counts[i]);
+        }
+    }
+    if(out_file == "-") {
+        sasi::hist::write(hist, bins, width, zeros, "value", std::cout);
+        return EXIT_SUCCESS;
+    }
+    std::ofstream out(out_file);
+    if(!out) {
+        return EXIT_FAILURE;
+    }
+    sasi::hist::write(hist, bins, width, zeros, "value", out);
+    return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// @private
+// GCOVR_EXCL_START
+TEST_CASE("write_histogram") {
+    std::vector<size_t> counts{0, 2, 0, 0, 1};
+    REQUIRE(write_histogram(counts, true, "test-hist.csv") == EXIT_SUCCESS);
+    std::ifstream in("test-hist.csv");
+    std::stringstream text;
+    text << in.rdbuf();
+    in.close();
+    CHECK(text.str() == "value,count\n1,2\n2,0\n3,0\n4,1\n");
+    REQUIRE(write_histogram(counts, false, "test-hist.csv",
+                            sasi::hist::binning::linear, 4) == EXIT_SUCCESS);
+    in.open("test-hist.csv");
+    text.str("");
+    text << in.rdbuf();
+    CHECK(text.str() == "value_min,value_max,count\n0,3,2\n4,7,1\n");
+    REQUIRE(std::filesystem::remove("test-hist.csv"));
+    CHECK(write_histogram(counts, false, "no-such-dir/test.csv") ==
+          EXIT_FAILURE);
+}
+// GCOVR_EXCL_STOP
+
+/**
+ * @brief Number of worker threads to use, 0 meaning all cores.
+ */
+size_t thread_count(size_t requested) {
+    if(requested > 0) {
+        return requested;
+    }
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
 sasi::args_t set_cli_options(CLI::App& app) {
     sasi::args_t args;
+    const CLI::Validator input_file = existing_input();
+    const std::string input_help =
+        "Input file(s): FASTA, or PHYLIP (.phy), Stockholm (.sto), Clustal "
+        "(.aln), A2M/A3M or FASTQ (.fq) by extension; ext:file sets the "
+        "format, tar:archive or .tar reads every member of an archive";
 
     // Commands - 1 required: gap & sequence
     args.gap = app.add_subcommand("gap", "Gap information");
     args.seq = app.add_subcommand("sequence", "Sequence information");
+    args.filter = app.add_subcommand(
+        "filter", "Write the records that pass all filters (FASTA)");
+    args.degap = app.add_subcommand(
+        "degap-columns", "Remove columns that are gaps in every record");
     app.require_subcommand(1);
 
-    // Gap subcommands - 1 required: frameshift, frequency, position, phase
+    // Gap subcommands - 1 required: frameshift, frequency, position, phase,
+    // joint, events, indels
     auto* frm = args.gap->add_subcommand(
         "frameshift", "Count gaps with length not multiple of 3");
     auto* frq = args.gap->add_subcommand("frequency", "Gap frequency");
     auto* pos = args.gap->add_subcommand("position", "Position of gaps");
     auto* pha = args.gap->add_subcommand("phase", "Distribution of gap phases");
+    auto* jnt = args.gap->add_subcommand(
+        "joint", "Joint distribution of gap length, phase and position");
+    auto* evt = args.gap->add_subcommand("events", "One row per gap");
+    auto* ind = args.gap->add_subcommand(
+        "indels", "Distinct gap runs and number of sequences sharing them");
     args.gap->require_subcommand(1);
 
     // Add input positional argument
-    frm->add_option("input", args.input, "Input file(s) (FASTA format)")
+    frm->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    frq->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    pos->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
-    frq->add_option("input", args.input, "Input file(s) (FASTA format)")
+        ->check(input_file);
+    pha->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
-    pos->add_option("input", args.input, "Input file(s) (FASTA format)")
+        ->check(input_file);
+    jnt->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
-    pha->add_option("input", args.input, "Input file(s) (FASTA format)")
+        ->check(input_file);
+    evt->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
+        ->check(input_file);
+    ind->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
 
-    // Seq subcommands - 1 required: stop, frameshift, ambiguous, subst_phase
+    // Seq subcommands - 1 required: stop, frameshift, ambiguous, subst_phase,
+    // window, composition, codons, distance, duplicates, translate
     auto* stop = args.seq->add_subcommand("stop", "Count early stop codons");
     auto* fram = args.seq->add_subcommand(
         "frameshift", "Count sequences with length not multiple of 3");
@@ -116,22 +251,85 @@ sasi::args_t set_cli_options(CLI::App& app) {
     args.seq->require_subcommand(1);
     auto* sub =
         args.seq->add_subcommand("subst", "Number of substitution per phase");
+    auto* win = args.seq->add_subcommand(
+        "window", "Gap, ambiguous and GC counts in sliding windows");
+    auto* cmp = args.seq->add_subcommand(
+        "composition", "Nucleotide composition and GC content");
+    auto* cod = args.seq->add_subcommand("codons", "Codon usage");
+    auto* dst = args.seq->add_subcommand(
+        "distance", "Pairwise p-distances between aligned sequences");
+    auto* dup = args.seq->add_subcommand("duplicates",
+                                         "Groups of identical sequences");
+    auto* trn = args.seq->add_subcommand(
+        "translate", "Translate nucleotide sequences to protein (FASTA)");
 
     // Add input positional argument
-    stop->add_option("input", args.input, "Input file(s) (FASTA format)")
+    stop->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    fram->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    amb->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    sub->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    win->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    cmp->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    cod->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
-    fram->add_option("input", args.input, "Input file(s) (FASTA format)")
+        ->check(input_file);
+    dst->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
-    amb->add_option("input", args.input, "Input file(s) (FASTA format)")
+        ->check(input_file);
+    dup->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
-    sub->add_option("input", args.input, "Input file(s) (FASTA format)")
+        ->check(input_file);
+    trn->add_option("input", args.input, input_help)
         ->take_all()
-        ->check(CLI::ExistingFile);
+        ->check(input_file);
+
+    // Filter command: predicates from the sequence statistics
+    args.filter->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    args.filter->add_option("--max-ambiguous", args.max_ambiguous,
+                            "Maximum ambiguous nucleotides per sequence");
+    args.filter
+        ->add_option("--max-gap-fraction", args.max_gap_fraction,
+                     "Maximum fraction of gaps per sequence (default: 1)")
+        ->check(CLI::Range(0.0, 1.0));
+    args.filter->add_flag("--no-stops", args.no_stops,
+                          "Drop sequences with early stop codons");
+    args.filter->add_flag("-l,--keep-last", args.stop_keep_last,
+                          "Count ending codons as early stop codons");
+    args.filter->add_flag("--no-frameshift", args.no_frameshift,
+                          "Drop sequences with length not multiple of 3");
+    args.filter->add_flag("-g,--discard-gaps", args.discard_gaps,
+                          "Remove gaps before analysis");
+    args.filter->add_option("-w,--line-width", args.line_width,
+                            "Wrap sequences every w characters (default: 0, "
+                            "no wrapping)");
+    args.filter->add_option("-o,--output", args.output, "Output file");
+
+    // Degap-columns command
+    args.degap->add_option("input", args.input, input_help)
+        ->take_all()
+        ->check(input_file);
+    args.degap->add_option("-w,--line-width", args.line_width,
+                           "Wrap sequences every w characters (default: 0, "
+                           "no wrapping)");
+    args.degap->add_option("-o,--output", args.output, "Output file");
 
     // Command & subcommand specific options & flags
+    args.gap->add_flag("-c,--drop-gap-columns", args.drop_gap_columns,
+                       "Remove columns that are gaps in every record");
     stop->add_option("-i,--information", args.stop_inf,
                      "Stop codons: total = 0, file = 1, sequence = 2");
     args.seq->add_flag("-g,--discard-gaps", args.discard_gaps,
@@ -139,20 +337,118 @@ sasi::args_t set_cli_options(CLI::App& app) {
     stop->add_flag("-l,--keep-last", args.stop_keep_last,
                    "Count ending codons as early stop codons");
     pha->add_option("-k,--gap-len", args.k, "Unit of gap length (default: 3)");
+    pha->add_option("--k-range", args.k_range,
+                    "Phases for every unit of gap length from min to max")
+        ->expected(2)
+        ->allow_extra_args(false);
+    jnt->add_option("-b,--bin-width", args.bin_width,
+                    "Width (%) of position bins (default: 1)");
+    frq->add_flag("-u,--unique-indels", args.unique_indels,
+                  "Count an indel shared by sequences of a file once");
+    frq->add_option("--bins", args.bins,
+                    "Length bins: exact, linear, log or auto (default: exact)")
+        ->check(CLI::IsMember({"exact", "linear", "log", "auto"}));
+    frq->add_option("-b,--bin-width", args.bin_width,
+                    "Width of linear length bins (default: 1)")
+        ->check(CLI::PositiveNumber);
+    frq->add_flag("-z,--zeros", args.zeros, "Include empty length bins");
+    evt->add_option("-f,--format", args.events_format,
+                    "Output format: csv or binary (default: csv)")
+        ->check(CLI::IsMember({"csv", "binary"}));
+    cmp->add_option("-i,--information", args.comp_inf,
+                    "Composition: total = 0, file = 1, sequence = 2");
+    sub->add_flag("-m,--matrix", args.subst_matrix,
+                  "Base pair matrix and Ti/Tv per phase");
+    cod->add_option("-i,--information", args.codon_inf,
+                    "Codon usage: total = 0, file = 1, sequence = 2");
+    cod->add_option("-c,--genetic-code", args.genetic_code,
+                    "NCBI genetic code (default: 1)");
+    cod->add_flag("--rscu", args.rscu, "Add relative synonymous codon usage");
+    cod->add_flag("-a,--amino-acids", args.amino_acids,
+                  "Sum codons by amino acid");
+    dst->add_option("-f,--format", args.distance_format,
+                    "Output format: phylip or binary (default: phylip)")
+        ->check(CLI::IsMember({"phylip", "binary"}));
+    trn->add_option("-c,--genetic-code", args.genetic_code,
+                    "NCBI genetic code (default: 1)");
+    auto* frame = trn->add_option("-f,--frame", args.frame,
+                                  "Reading frame: 1-3 forward, 4-6 reverse "
+                                  "complement (default: 1)")
+                      ->check(CLI::Range(1, 6));
+    trn->add_flag("--six-frames", args.six_frames, "Translate all six frames")
+        ->excludes(frame);
+    trn->add_flag("--counts", args.residue_counts,
+                  "Write amino acid counts per file instead of sequences");
+    trn->add_option("-w,--line-width", args.line_width,
+                    "Wrap sequences every w characters (default: 0, no "
+                    "wrapping)");
+    for(auto* sc : {amb, cmp}) {
+        sc->add_option("-q,--min-quality", args.min_quality,
+                       "Also count FASTQ bases with Phred quality below q "
+                       "(default: 0, off)");
+        sc->add_option("--phred-offset", args.phred_offset,
+                       "FASTQ quality offset (default: 33)")
+            ->check(CLI::IsMember({33, 64}));
+    }
+    win->add_option("--size", args.window_size,
+                    "Window length (default: 100)")
+        ->check(CLI::PositiveNumber);
+    win->add_option("--step", args.window_step,
+                    "Distance between window starts (default: 100)")
+        ->check(CLI::PositiveNumber);
 
     // Add output option to all subcommands
     frm->add_option("-o,--output", args.output, "Output file");
     frq->add_option("-o,--output", args.output, "Output file");
     pos->add_option("-o,--output", args.output, "Output file");
     pha->add_option("-o,--output", args.output, "Output file");
+    jnt->add_option("-o,--output", args.output, "Output file");
+    evt->add_option("-o,--output", args.output, "Output file");
+    ind->add_option("-o,--output", args.output, "Output file");
     stop->add_option("-o,--output", args.output, "Output file");
     fram->add_option("-o,--output", args.output, "Output file");
     amb->add_option("-o,--output", args.output, "Output file");
     sub->add_option("-o,--output", args.output, "Output file");
+    win->add_option("-o,--output", args.output, "Output file");
+    cmp->add_option("-o,--output", args.output, "Output file");
+    cod->add_option("-o,--output", args.output, "Output file");
+    dst->add_option("-o,--output", args.output, "Output file");
+    dup->add_option("-o,--output", args.output, "Output file");
+    trn->add_option("-o,--output", args.output, "Output file");
 
     // Option to ignore empty files
     app.add_flag("--ignore", args.ignore_empty, "Ignore empty files");
 
+    // Worker threads
+    app.add_option("-t,--threads", args.threads,
+                   "Number of threads, 0 = all cores (default: 1)");
+
+    // Duplicate records
+    app.add_flag("--dedup", args.dedup,
+                 "Drop repeated identical records of a file before counting");
+
+    // Record sampling
+    auto* fraction = app.add_option(
+        "--sample-fraction", args.sample_fraction,
+        "Keep each record with this probability; totals become estimates");
+    fraction->check(CLI::Range(0.0, 1.0));
+    app.add_option("--sample-records", args.sample_records,
+                   "Keep this many random records per file")
+        ->excludes(fraction);
+    app.add_option("--seed", args.seed, "Random seed of sampling (default: 1)");
+
+    // Stage profiler
+    app.add_flag("--profile", args.profile,
+                 "Report time and throughput of each stage");
+    app.add_option("--profile-out", args.profile_out,
+                   "Write profile report as JSON (default: stderr)");
+    app.add_option("--profile-top", args.profile_top,
+                   "Number of slowest files in profile (default: 10)");
+    app.add_flag("--profile-memory", args.profile_memory,
+                 "Add allocation counts and peak heap per stage to profile");
+    app.add_flag("--perf-counters", args.perf_counters,
+                 "Add hardware counters per stage to profile (Linux)");
+
     return args;
 }
 }  // namespace sasi::utils
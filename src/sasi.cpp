@@ -3,6 +3,7 @@
 #include <sasi/gap.hpp>
 #include <sasi/output.hpp>
 #include <sasi/sequence.hpp>
+#include <sasi/tar.hpp>
 #include <sasi/utils.hpp>
 
 int main(int argc, char* argv[]) {
@@ -11,6 +12,7 @@ int main(int argc, char* argv[]) {
     try {
         sasi::args_t args = sasi::utils::set_cli_options(app);
         CLI11_PARSE(app, argc, argv);
+        args.input = sasi::tar::expand(args.input);
 
         // set output stream pointer
         std::ostream* pout(nullptr);
@@ -18,32 +20,136 @@ int main(int argc, char* argv[]) {
         if(args.output.empty()) {
             pout = &std::cout;
         } else {
-            outfile.open(args.output);
+            // binary distance matrices and gap events are written as is
+            bool binary = args.distance_format == "binary" ||
+                          args.events_format == "binary";
+            outfile.open(args.output, binary ? std::ios::out | std::ios::binary
+                                             : std::ios::out);
             pout = &outfile;
         }
         std::ostream& out = *pout;
 
+        sasi::memory::enable(args.profile_memory);
+        if(args.perf_counters && !sasi::perf::enable()) {
+            std::cerr << "WARNING: hardware counters unavailable ("
+                      << sasi::perf::error() << "), reporting timing only."
+                      << std::endl;
+        }
+        sasi::profile::enable(args.profile || args.profile_memory ||
+                              args.perf_counters);
+
+        // counts from sampled records are reported as estimates
+        bool sampled = sasi::sample::active(args);
+
+        // per-record listings are written for the sampled records only
+        bool listing =
+            app.got_subcommand("filter") ||
+            app.got_subcommand("degap-columns") ||
+            (app.got_subcommand("gap") &&
+             args.gap->got_subcommand("events")) ||
+            (app.got_subcommand("sequence") &&
+             (args.seq->got_subcommand("distance") ||
+              args.seq->got_subcommand("duplicates") ||
+              args.seq->got_subcommand("translate") ||
+              args.seq->got_subcommand("window")));
+        if(sampled && listing) {
+            std::cerr << "WARNING: output lists only the sampled records, "
+                         "not all records."
+                      << std::endl;
+        }
+
         // gap command
         if(app.got_subcommand("gap")) {
-            if(args.gap->got_subcommand("frequency")) {
-                sasi::gap::output::frequency(sasi::gap::frequency(args), out);
+            if(sampled && !args.gap->got_subcommand("events")) {
+                sasi::gap::verb statistic{sasi::gap::verb::FREQ};
+                if(args.gap->got_subcommand("frameshift")) {
+                    statistic = sasi::gap::verb::FRMST;
+                } else if(args.gap->got_subcommand("phase")) {
+                    statistic = args.k_range.empty()
+                                    ? sasi::gap::verb::PHASE
+                                    : sasi::gap::verb::PHASE_RANGE;
+                } else if(args.gap->got_subcommand("position")) {
+                    statistic = sasi::gap::verb::POSITION;
+                } else if(args.gap->got_subcommand("joint")) {
+                    statistic = sasi::gap::verb::JOINT;
+                } else if(args.gap->got_subcommand("indels")) {
+                    statistic = sasi::gap::verb::INDELS;
+                }
+                sasi::sample::write(sasi::gap::estimate(args, statistic), out);
+
+            } else if(args.gap->got_subcommand("frequency")) {
+                if(args.bins == "exact" && !args.zeros) {
+                    sasi::gap::output::frequency(sasi::gap::frequency(args),
+                                                 out);
+                } else {
+                    sasi::gap::output::histogram(sasi::gap::histogram(args),
+                                                 args, out);
+                }
 
             } else if(args.gap->got_subcommand("frameshift")) {
                 sasi::gap::output::frameshift(
                     sasi::gap::frameshift(sasi::gap::frequency(args)), out);
 
             } else if(args.gap->got_subcommand("phase")) {
-                sasi::gap::output::phase(sasi::gap::phase(args), out);
+                if(args.k_range.empty()) {
+                    sasi::gap::output::phase(sasi::gap::phase(args), out);
+                } else {
+                    sasi::gap::output::phase_range(sasi::gap::phase_range(args),
+                                                   args.k_range[0], out);
+                }
 
             } else if(args.gap->got_subcommand("position")) {
                 sasi::gap::output::position(sasi::gap::position(args), out);
+
+            } else if(args.gap->got_subcommand("joint")) {
+                sasi::gap::output::joint(sasi::gap::joint(args), out);
+
+            } else if(args.gap->got_subcommand("indels")) {
+                sasi::gap::output::indels(sasi::gap::indels(args), args.input,
+                                          out);
+
+            } else if(args.gap->got_subcommand("events")) {
+                sasi::gap::output::events_header(args.events_format,
+                                                 args.input, out);
+                sasi::gap::events(args, [&args, &out](const auto& event) {
+                    sasi::gap::output::event(event, args.events_format, out);
+                });
             }
-            return EXIT_SUCCESS;
         }
 
         // sequence command
         if(app.got_subcommand("sequence")) {
-            if(args.seq->got_subcommand("ambiguous")) {
+            if(sampled && args.seq->got_subcommand("ambiguous")) {
+                sasi::sample::write(
+                    sasi::seq::estimate(args, sasi::seq::verb::AMB), out);
+
+            } else if(sampled && args.seq->got_subcommand("frameshift")) {
+                sasi::sample::write(
+                    sasi::seq::estimate(args, sasi::seq::verb::FRMST), out);
+
+            } else if(sampled && args.seq->got_subcommand("stop")) {
+                sasi::sample::write(
+                    sasi::seq::estimate(args, sasi::seq::verb::STOP), out);
+
+            } else if(sampled && args.seq->got_subcommand("composition")) {
+                sasi::sample::write(
+                    sasi::seq::estimate(args, sasi::seq::verb::COMP), out);
+
+            } else if(sampled && args.seq->got_subcommand("codons")) {
+                sasi::sample::write(
+                    sasi::seq::estimate(args, sasi::seq::verb::CODON), out);
+
+            } else if(sampled && args.seq->got_subcommand("subst")) {
+                throw std::invalid_argument(
+                    "Substitutions are counted over pairs of records, not "
+                    "estimated from a sample.");
+
+            } else if(args.seq->got_subcommand("ambiguous") &&
+                      args.min_quality > 0) {
+                sasi::seq::output::ambiguous(
+                    sasi::seq::ambiguous_quality(args), out);
+
+            } else if(args.seq->got_subcommand("ambiguous")) {
                 sasi::seq::output::ambiguous(sasi::seq::ambiguous(args), out);
 
             } else if(args.seq->got_subcommand("frameshift")) {
@@ -53,10 +159,82 @@ int main(int argc, char* argv[]) {
                 sasi::seq::output::stop_codons(sasi::seq::stop_codons(args),
                                                out);
             } else if(args.seq->got_subcommand("subst")) {
-                sasi::seq::output::subst(sasi::seq::subst(args), out);
+                if(args.subst_matrix) {
+                    sasi::seq::output::subst_matrix(
+                        sasi::seq::subst_matrix(args), out);
+                } else {
+                    sasi::seq::output::subst(sasi::seq::subst(args), out);
+                }
+
+            } else if(args.seq->got_subcommand("composition")) {
+                sasi::seq::output::composition(sasi::seq::composition(args),
+                                               args.comp_inf, out,
+                                               args.min_quality > 0);
+
+            } else if(args.seq->got_subcommand("codons")) {
+                sasi::seq::output::codons(sasi::seq::codons(args), args, out);
+
+            } else if(args.seq->got_subcommand("distance")) {
+                sasi::seq::output::distance(sasi::seq::distance(args),
+                                            args.distance_format, out);
+
+            } else if(args.seq->got_subcommand("duplicates")) {
+                sasi::seq::output::duplicates(sasi::seq::duplicates(args), out);
+
+            } else if(args.seq->got_subcommand("translate")) {
+                if(args.residue_counts) {
+                    std::vector<std::pair<std::string,
+                                          sasi::seq::residue_counts_t>>
+                        rows;
+                    sasi::seq::translate(args, [&rows](const auto& protein) {
+                        rows.emplace_back(protein.path.string(),
+                                          sasi::seq::count_residues(protein));
+                    });
+                    sasi::seq::output::residues(rows, out);
+                } else {
+                    outfile.close();
+                    sasi::fasta::writer_t writer(args.output, args.line_width);
+                    sasi::seq::translate(args, [&writer](const auto& protein) {
+                        writer.write(protein);
+                    });
+                }
+
+            } else if(args.seq->got_subcommand("window")) {
+                sasi::seq::output::window_header(out);
+                sasi::seq::window(args, [&args, &out](const auto& file,
+                                                      const auto& name,
+                                                      const auto& sums) {
+                    sasi::seq::output::window(file, name, sums,
+                                              args.window_size,
+                                              args.window_step, out);
+                });
             }
-            return EXIT_SUCCESS;
         }
+
+        // filter command
+        if(app.got_subcommand("filter")) {
+            // records are written through their own file descriptor
+            outfile.close();
+            sasi::fasta::writer_t writer(args.output, args.line_width);
+            sasi::seq::filter(args, [&writer](const auto& data,
+                                              const auto& keep) {
+                writer.write(data, keep);
+            });
+        }
+
+        // degap-columns command
+        if(app.got_subcommand("degap-columns")) {
+            outfile.close();
+            sasi::fasta::writer_t writer(args.output, args.line_width);
+            sasi::gap::degap_columns(
+                args, [&writer](const auto& data) { writer.write(data); });
+        }
+
+        if(sasi::profile::enabled()) {
+            out.flush();
+            sasi::profile::write_report(args.profile_out, args.profile_top);
+        }
+        return EXIT_SUCCESS;
     } catch(std::exception& e) {
         std::cerr << "ERROR: " << e.what() << std::endl;
     }